@@ -0,0 +1,88 @@
+//License: GNU General Public License, Version 3
+/*
+ *   pbkdf2_bench.c - PBKDF2 iterations per second for one password and for a batch of passwords
+ *
+ *   Built once per algorithm:
+ *       cc -O2 -pthread pbkdf2_bench.c ../sha256/sha256*.c -o pbkdf2_bench_sha256
+ *       cc -O2 -pthread -DBENCH_SHA512 pbkdf2_bench.c ../sha512/sha512*.c -o pbkdf2_bench_sha512
+ *
+ *   Usage: pbkdf2_bench [iterations] [batch]
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include <stdio.h>
+#include <time.h>
+
+#ifdef BENCH_SHA512
+#include "../sha512/sha512.h"
+#define ALGORITHM "sha512"
+#define DIGEST_LENGTH 64
+#define pbkdf2 sha512_pbkdf2
+#define pbkdf2_many sha512_pbkdf2_many
+#else
+#include "../sha256/sha256.h"
+#define ALGORITHM "sha256"
+#define DIGEST_LENGTH 32
+#define pbkdf2 sha256_pbkdf2
+#define pbkdf2_many sha256_pbkdf2_many
+#endif
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t iterations = argc > 1 ? (uint32_t) strtoul(argv[1], NULL, 10) : 600000;
+	size_t batch = argc > 2 ? (size_t) strtoul(argv[2], NULL, 10) : 64;
+	const char* salt = "pbkdf2-bench-salt";
+	uint8_t key[DIGEST_LENGTH];
+
+	if(iterations == 0 || batch == 0)
+	{
+		fprintf(stderr, "usage: %s [iterations] [batch]\n", argv[0]);
+		return 1;
+	}
+
+	double start = now();
+	pbkdf2("password", 8, salt, strlen(salt), iterations, key, DIGEST_LENGTH);
+	double elapsed = now() - start;
+
+	printf("algorithm=%s mode=single passwords=1 iterations=%u seconds=%.6f iterations_per_second=%.0f\n", ALGORITHM, iterations, elapsed, iterations / elapsed);
+
+	char (*passwords)[16] = malloc(16 * batch);
+	const uint8_t** pointers = malloc(sizeof(uint8_t *) * batch);
+	size_t* lengths = malloc(sizeof(size_t) * batch);
+	uint8_t* keys = malloc(DIGEST_LENGTH * batch);
+
+	if(passwords == NULL || pointers == NULL || lengths == NULL || keys == NULL)
+	{
+		fprintf(stderr, "%s: out of memory for %zu passwords\n", argv[0], batch);
+		free(passwords);
+		free(pointers);
+		free(lengths);
+		free(keys);
+		return 1;
+	}
+
+	for(size_t i = 0; i < batch; i++)
+	{
+		lengths[i] = (size_t) snprintf(passwords[i], 16, "password%zu", i);
+		pointers[i] = (const uint8_t *) passwords[i];
+	}
+
+	start = now();
+	pbkdf2_many(pointers, lengths, batch, salt, strlen(salt), iterations, keys, DIGEST_LENGTH);
+	elapsed = now() - start;
+
+	printf("algorithm=%s mode=batch passwords=%zu iterations=%u seconds=%.6f iterations_per_second=%.0f\n", ALGORITHM, batch, iterations, elapsed, batch * (double) iterations / elapsed);
+
+	free(passwords);
+	free(pointers);
+	free(lengths);
+	free(keys);
+	return 0;
+}
@@ -0,0 +1,383 @@
+//License: GNU General Public License, Version 3
+/*
+ *   shabench.c - Known-answer gate, throughput, latency and core scaling for every compression backend
+ *
+ *   Built once per algorithm:
+ *       cc -O2 -pthread shabench.c ../sha256/sha256*.c -o shabench_sha256
+ *       cc -O2 -pthread -DBENCH_SHA512 shabench.c ../sha512/sha512*.c -o shabench_sha512
+ *
+ *   Usage: shabench [--max-size bytes] [--seconds s] [--samples n] [--threads n]
+ *
+ *   Every result is one line of key=value pairs. A backend that fails its known-answer tests
+ *   is reported and not benchmarked, and the exit status is 1.
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define cycles() __rdtsc()
+#else
+#define cycles() ((uint64_t) 0)
+#endif
+
+#ifdef BENCH_SHA512
+#include "../sha512/sha512.h"
+#define ALGORITHM "sha512"
+#define DIGEST_LENGTH 64
+#define digest_data sha512_digest
+#define known_answers sha512_known_answers
+#define set_backend(b) sha512_set_backend((SHA512Backend) (b))
+#define get_backend sha512_get_backend
+static const struct { int backend; const char* name; } backends[] = {
+	{ SHA512_BACKEND_SCALAR, "scalar" },
+	{ SHA512_BACKEND_AVX2, "avx2" }
+};
+#else
+#include "../sha256/sha256.h"
+#define ALGORITHM "sha256"
+#define DIGEST_LENGTH 32
+#define digest_data sha256_digest
+#define known_answers sha256_known_answers
+#define set_backend(b) sha256_set_backend((SHA256Backend) (b))
+#define get_backend sha256_get_backend
+static const struct { int backend; const char* name; } backends[] = {
+	{ SHA256_BACKEND_SCALAR, "scalar" },
+	{ SHA256_BACKEND_SHANI, "shani" }
+};
+static const struct { SHA256ManyBackend backend; const char* name; } many_backends[] = {
+	{ SHA256_MANY_SERIAL, "serial" },
+	{ SHA256_MANY_AVX2, "avx2" },
+	{ SHA256_MANY_AVX512, "avx512" }
+};
+#endif
+
+#define NUMBER_OF_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+#define SCALING_BUFFER (1 << 20)
+
+typedef struct BenchOptions{
+	size_t max_size;
+	double seconds;
+	size_t samples;
+	unsigned threads;
+} BenchOptions;
+
+typedef struct ScalingWorker{
+	pthread_t thread;
+	double seconds;
+	uint64_t bytes;
+} ScalingWorker;
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+//Repeats one size until the time budget is spent; cycles are TSC reference cycles, not core cycles
+static void throughput(const char* backend, const uint8_t* buffer, size_t size, double seconds)
+{
+	uint8_t digest[DIGEST_LENGTH];
+	uint64_t iterations = 0;
+	uint64_t start_cycles = cycles();
+	double start = now();
+	double elapsed;
+
+	do
+	{
+		digest_data(buffer, size, digest);
+		iterations++;
+	} while((elapsed = now() - start) < seconds);
+
+	double total_cycles = (double) (cycles() - start_cycles);
+	double bytes = (double) size * iterations;
+
+	printf("algorithm=%s backend=%s test=throughput size=%zu iterations=%llu seconds=%.6f gb_per_second=%.4f cycles_per_byte=%.3f cycles_per_call=%.1f\n",
+		ALGORITHM, backend, size, (unsigned long long) iterations, elapsed, bytes / elapsed * 1e-9, size > 0 ? total_cycles / bytes : 0.0, total_cycles / iterations);
+}
+
+//Times every call on its own; the clock is read around each call, so its overhead is part of every sample
+static void latency(const char* backend, const uint8_t* buffer, size_t size, size_t samples, double* times)
+{
+	uint8_t digest[DIGEST_LENGTH];
+
+	for(size_t i = 0; i < samples; i++)
+	{
+		double start = now();
+		digest_data(buffer, size, digest);
+		times[i] = (now() - start) * 1e9;
+	}
+
+	qsort(times, samples, sizeof(double), compare_doubles);
+
+	printf("algorithm=%s backend=%s test=latency size=%zu samples=%zu p50_ns=%.0f p90_ns=%.0f p99_ns=%.0f p999_ns=%.0f max_ns=%.0f\n",
+		ALGORITHM, backend, size, samples, times[samples / 2], times[samples * 9 / 10], times[samples * 99 / 100], times[samples * 999 / 1000], times[samples - 1]);
+}
+
+static void* scaling_worker(void* argument)
+{
+	ScalingWorker* worker = (ScalingWorker *) argument;
+	uint8_t* buffer = (uint8_t *) malloc(SCALING_BUFFER);
+	uint8_t digest[DIGEST_LENGTH];
+	double start = now();
+
+	if(buffer == NULL)
+	{
+		return NULL;
+	}
+	memset(buffer, 0x5a, SCALING_BUFFER);
+
+	do
+	{
+		digest_data(buffer, SCALING_BUFFER, digest);
+		worker->bytes += SCALING_BUFFER;
+	} while(now() - start < worker->seconds);
+
+	free(buffer);
+	return NULL;
+}
+
+//Every thread hashes its own 1 MiB buffer, so the result is compute bound rather than a shared-cache test
+static void scaling(const char* backend, unsigned threads, double seconds)
+{
+	ScalingWorker* workers = (ScalingWorker *) calloc(threads, sizeof(ScalingWorker));
+	unsigned started = 0;
+	uint64_t bytes = 0;
+
+	if(workers == NULL)
+	{
+		return;
+	}
+
+	double start = now();
+	for(; started < threads; started++)
+	{
+		workers[started].seconds = seconds;
+		if(pthread_create(&workers[started].thread, NULL, scaling_worker, &workers[started]) != 0)
+		{
+			break;
+		}
+	}
+	for(unsigned i = 0; i < started; i++)
+	{
+		pthread_join(workers[i].thread, NULL);
+		bytes += workers[i].bytes;
+	}
+	double elapsed = now() - start;
+
+	printf("algorithm=%s backend=%s test=scaling threads=%u seconds=%.6f gb_per_second=%.4f\n",
+		ALGORITHM, backend, started, elapsed, bytes / elapsed * 1e-9);
+	free(workers);
+}
+
+#ifndef BENCH_SHA512
+//Equal-length messages through the lanes, reported per message so it compares with the latency lines
+static void batch(const char* backend, const char* many_backend, const uint8_t* buffer, size_t size, double seconds)
+{
+	const uint8_t* messages[64];
+	size_t lengths[64];
+	uint8_t digests[32 * 64];
+	uint64_t calls = 0;
+	double start = now();
+	double elapsed;
+
+	for(uint8_t i = 0; i < 64; i++)
+	{
+		messages[i] = buffer + i;
+		lengths[i] = size;
+	}
+
+	do
+	{
+		sha256_hash_many(messages, lengths, 64, digests);
+		calls++;
+	} while((elapsed = now() - start) < seconds);
+
+	printf("algorithm=%s backend=%s many_backend=%s test=batch size=%zu messages=%llu seconds=%.6f ns_per_message=%.1f gb_per_second=%.4f\n",
+		ALGORITHM, backend, many_backend, size, (unsigned long long) (64 * calls), elapsed, elapsed * 1e9 / (64 * calls), (double) size * 64 * calls / elapsed * 1e-9);
+}
+
+//sha256d over 64-byte inputs, one at a time and through the lanes
+static void double_hash(const char* backend, const char* many_backend, const uint8_t* buffer, double seconds)
+{
+	uint8_t digests[32 * 64];
+	uint64_t calls = 0;
+	double start = now();
+	double elapsed;
+
+	do
+	{
+		for(uint8_t i = 0; i < 64; i++)
+		{
+			sha256d_64(buffer + 64 * i, digests + 32 * i);
+		}
+		calls++;
+	} while((elapsed = now() - start) < seconds);
+
+	printf("algorithm=%s backend=%s many_backend=%s test=sha256d mode=single size=64 messages=%llu seconds=%.6f ns_per_message=%.1f\n",
+		ALGORITHM, backend, many_backend, (unsigned long long) (64 * calls), elapsed, elapsed * 1e9 / (64 * calls));
+
+	calls = 0;
+	start = now();
+	do
+	{
+		sha256d_64_many(buffer, 64, digests);
+		calls++;
+	} while((elapsed = now() - start) < seconds);
+
+	printf("algorithm=%s backend=%s many_backend=%s test=sha256d mode=batch size=64 messages=%llu seconds=%.6f ns_per_message=%.1f\n",
+		ALGORITHM, backend, many_backend, (unsigned long long) (64 * calls), elapsed, elapsed * 1e9 / (64 * calls));
+}
+#endif
+
+static int parse_options(int argc, char** argv, BenchOptions* options)
+{
+	options->max_size = (size_t) 1 << 30;
+	options->seconds = 0.2;
+	options->samples = 100000;
+	options->threads = 0;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(i + 1 < argc && strcmp(argv[i], "--max-size") == 0)
+		{
+			options->max_size = (size_t) strtoull(argv[++i], NULL, 10);
+		}
+		else if(i + 1 < argc && strcmp(argv[i], "--seconds") == 0)
+		{
+			options->seconds = strtod(argv[++i], NULL);
+		}
+		else if(i + 1 < argc && strcmp(argv[i], "--samples") == 0)
+		{
+			options->samples = (size_t) strtoull(argv[++i], NULL, 10);
+		}
+		else if(i + 1 < argc && strcmp(argv[i], "--threads") == 0)
+		{
+			options->threads = (unsigned) strtoul(argv[++i], NULL, 10);
+		}
+		else
+		{
+			return -1;
+		}
+	}
+
+	if(options->threads == 0)
+	{
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		options->threads = online > 0 ? (unsigned) online : 1;
+	}
+	return options->samples > 0 && options->seconds > 0 ? 0 : -1;
+}
+
+int main(int argc, char** argv)
+{
+	static const size_t latency_sizes[] = { 0, 64, 256, 1024 };
+	BenchOptions options;
+	int failed = 0;
+
+	if(parse_options(argc, argv, &options) != 0)
+	{
+		fprintf(stderr, "usage: %s [--max-size bytes] [--seconds s] [--samples n] [--threads n]\n", argv[0]);
+		return 1;
+	}
+
+	//The buffer is sized for the largest message, and at least for the batch tests' 64 staggered or packed inputs
+	size_t buffer_size = (options.max_size > 4096 ? options.max_size : 4096) + 64;
+	uint8_t* buffer = (uint8_t *) malloc(buffer_size);
+	double* times = (double *) malloc(sizeof(double) * options.samples);
+
+	if(buffer == NULL || times == NULL)
+	{
+		fprintf(stderr, "%s: cannot allocate %zu bytes\n", argv[0], buffer_size);
+		return 1;
+	}
+	for(size_t i = 0; i < buffer_size; i++)
+	{
+		*(buffer + i) = (uint8_t) (i * 131 + 7);
+	}
+
+	int initial_backend = (int) get_backend();
+
+	for(size_t b = 0; b < NUMBER_OF_BACKENDS; b++)
+	{
+		const char* name = backends[b].name;
+
+		if(set_backend(backends[b].backend) != 0)
+		{
+			printf("algorithm=%s backend=%s test=kat status=unsupported\n", ALGORITHM, name);
+			continue;
+		}
+
+		int failures = known_answers();
+		printf("algorithm=%s backend=%s test=kat status=%s failures=%d\n", ALGORITHM, name, failures == 0 ? "pass" : "fail", failures);
+		if(failures != 0)
+		{
+			failed = 1;
+			continue;
+		}
+
+		//0 B, then powers of four from 1 B up to the maximum
+		throughput(name, buffer, 0, options.seconds);
+		for(size_t size = 1; size <= options.max_size; size *= 4)
+		{
+			throughput(name, buffer, size, options.seconds);
+			if(size > options.max_size / 4 && size != options.max_size)
+			{
+				throughput(name, buffer, options.max_size, options.seconds);
+			}
+		}
+
+		for(size_t i = 0; i < sizeof(latency_sizes) / sizeof(latency_sizes[0]); i++)
+		{
+			latency(name, buffer, latency_sizes[i], options.samples, times);
+		}
+
+		scaling(name, 1, options.seconds);
+		if(options.threads > 1)
+		{
+			scaling(name, options.threads, options.seconds);
+		}
+
+#ifndef BENCH_SHA512
+		SHA256ManyBackend initial_many_backend = sha256_get_many_backend();
+
+		for(size_t m = 0; m < sizeof(many_backends) / sizeof(many_backends[0]); m++)
+		{
+			if(sha256_set_many_backend(many_backends[m].backend) != 0)
+			{
+				continue;
+			}
+
+			failures = known_answers();
+			printf("algorithm=%s backend=%s many_backend=%s test=kat status=%s failures=%d\n", ALGORITHM, name, many_backends[m].name, failures == 0 ? "pass" : "fail", failures);
+			if(failures != 0)
+			{
+				failed = 1;
+				continue;
+			}
+
+			batch(name, many_backends[m].name, buffer, 64, options.seconds);
+			batch(name, many_backends[m].name, buffer, 1024, options.seconds);
+			double_hash(name, many_backends[m].name, buffer, options.seconds);
+		}
+		sha256_set_many_backend(initial_many_backend);
+#endif
+	}
+
+	set_backend(initial_backend);
+	free(buffer);
+	free(times);
+	return failed;
+}
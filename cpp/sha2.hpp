@@ -0,0 +1,310 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha2.hpp - Header-only constexpr SHA256 and SHA512 for C++17
+ *
+ *   One templated core, parameterised by the word size, round count and constants of sha256.h
+ *   and sha512.h, runs both at compile time and at run time:
+ *
+ *       constexpr auto id = sha2::sha256("routing.key");        //std::array<uint8_t, 32>
+ *       static_assert(sha2::key64(id) == sha2::key64(sha2::sha256("routing.key")));
+ *
+ *   The C headers cannot be included here, since their macros and K tables clash with each
+ *   other and are not constexpr, so the constants are repeated below. For long messages at run
+ *   time the C library, with its SHA-NI, AVX2 and multi-buffer kernels, is much faster.
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#ifndef SHA2_HPP
+#define SHA2_HPP
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace sha2
+{
+	namespace detail
+	{
+		template <typename Word>
+		constexpr Word rotr(Word x, unsigned n)
+		{
+			return (x >> n) | (x << (sizeof(Word) * 8 - n));
+		}
+
+		struct SHA256Traits
+		{
+			using Word = uint32_t;
+			static constexpr size_t block_size = 64;
+			static constexpr size_t digest_size = 32;
+			static constexpr size_t rounds = 64;
+
+			static constexpr std::array<Word, 8> initial_hashes = {
+				0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+			};
+
+			static constexpr std::array<Word, 64> K = {
+				0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+				0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+				0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+				0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+				0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+				0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+				0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+				0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
+			};
+
+			static constexpr Word S0(Word x) { return rotr(x, 2) ^ rotr(x, 13) ^ rotr(x, 22); }
+			static constexpr Word S1(Word x) { return rotr(x, 6) ^ rotr(x, 11) ^ rotr(x, 25); }
+			static constexpr Word s0(Word x) { return rotr(x, 7) ^ rotr(x, 18) ^ (x >> 3); }
+			static constexpr Word s1(Word x) { return rotr(x, 17) ^ rotr(x, 19) ^ (x >> 10); }
+		};
+
+		struct SHA512Traits
+		{
+			using Word = uint64_t;
+			static constexpr size_t block_size = 128;
+			static constexpr size_t digest_size = 64;
+			static constexpr size_t rounds = 80;
+
+			static constexpr std::array<Word, 8> initial_hashes = {
+				0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+				0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179
+			};
+
+			static constexpr std::array<Word, 80> K = {
+				0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc,
+				0x3956c25bf348b538, 0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118,
+				0xd807aa98a3030242, 0x12835b0145706fbe, 0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2,
+				0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235, 0xc19bf174cf692694,
+				0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+				0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5,
+				0x983e5152ee66dfab, 0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4,
+				0xc6e00bf33da88fc2, 0xd5a79147930aa725, 0x06ca6351e003826f, 0x142929670a0e6e70,
+				0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed, 0x53380d139d95b3df,
+				0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+				0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30,
+				0xd192e819d6ef5218, 0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8,
+				0x19a4c116b8d2d0c8, 0x1e376c085141ab53, 0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8,
+				0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373, 0x682e6ff3d6b2b8a3,
+				0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+				0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b,
+				0xca273eceea26619c, 0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178,
+				0x06f067aa72176fba, 0x0a637dc5a2c898a6, 0x113f9804bef90dae, 0x1b710b35131c471b,
+				0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc, 0x431d67c49c100d4c,
+				0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
+			};
+
+			static constexpr Word S0(Word x) { return rotr(x, 28) ^ rotr(x, 34) ^ rotr(x, 39); }
+			static constexpr Word S1(Word x) { return rotr(x, 14) ^ rotr(x, 18) ^ rotr(x, 41); }
+			static constexpr Word s0(Word x) { return rotr(x, 1) ^ rotr(x, 8) ^ (x >> 7); }
+			static constexpr Word s1(Word x) { return rotr(x, 19) ^ rotr(x, 61) ^ (x >> 6); }
+		};
+	}
+
+	//Streaming hasher with the same init/update/final shape as the C Context
+	template <typename Traits>
+	class Hasher
+	{
+	public:
+		using Word = typename Traits::Word;
+		using Digest = std::array<uint8_t, Traits::digest_size>;
+
+		constexpr Hasher() : hashes(Traits::initial_hashes)
+		{
+		}
+
+		constexpr void update(const uint8_t* data, size_t length)
+		{
+			length_in_bytes += length;
+
+			for(size_t i = 0; i < length; i++)
+			{
+				block[block_length++] = data[i];
+				if(block_length == Traits::block_size)
+				{
+					compress();
+					block_length = 0;
+				}
+			}
+		}
+
+		constexpr void update(std::string_view data)
+		{
+			length_in_bytes += data.size();
+
+			for(size_t i = 0; i < data.size(); i++)
+			{
+				block[block_length++] = static_cast<uint8_t>(data[i]);
+				if(block_length == Traits::block_size)
+				{
+					compress();
+					block_length = 0;
+				}
+			}
+		}
+
+		constexpr Digest final()
+		{
+			constexpr size_t length_field = Traits::block_size / 8;
+			Digest digest{};
+
+			block[block_length++] = 128;
+			if(block_length > Traits::block_size - length_field)
+			{
+				while(block_length < Traits::block_size)
+				{
+					block[block_length++] = 0;
+				}
+				compress();
+				block_length = 0;
+			}
+			while(block_length < Traits::block_size)
+			{
+				block[block_length++] = 0;
+			}
+
+			//The length field is 64 bits for SHA256 and 128 for SHA512; a byte count never needs more than 67,
+			//so the only bits beyond the low 64 go to the last byte of SHA512's upper half
+			uint64_t low = length_in_bytes << 3;
+			if constexpr(Traits::block_size == 128)
+			{
+				block[Traits::block_size - 9] = static_cast<uint8_t>(length_in_bytes >> 61);
+			}
+			for(size_t i = 0; i < 8; i++)
+			{
+				block[Traits::block_size - 1 - i] = static_cast<uint8_t>(low >> (8 * i));
+			}
+			compress();
+
+			for(size_t i = 0; i < Traits::digest_size; i++)
+			{
+				digest[i] = static_cast<uint8_t>(hashes[i / sizeof(Word)] >> (8 * (sizeof(Word) - 1 - i % sizeof(Word))));
+			}
+			return digest;
+		}
+
+	private:
+		constexpr void compress()
+		{
+			std::array<Word, Traits::rounds> W{};
+
+			for(size_t j = 0; j < 16; j++)
+			{
+				for(size_t b = 0; b < sizeof(Word); b++)
+				{
+					W[j] = (W[j] << 8) | block[sizeof(Word) * j + b];
+				}
+			}
+			for(size_t j = 16; j < Traits::rounds; j++)
+			{
+				W[j] = Traits::s1(W[j - 2]) + W[j - 7] + Traits::s0(W[j - 15]) + W[j - 16];
+			}
+
+			Word a = hashes[0];
+			Word b = hashes[1];
+			Word c = hashes[2];
+			Word d = hashes[3];
+			Word e = hashes[4];
+			Word f = hashes[5];
+			Word g = hashes[6];
+			Word h = hashes[7];
+
+			for(size_t r = 0; r < Traits::rounds; r++)
+			{
+				Word T1 = h + Traits::S1(e) + ((e & f) ^ (~e & g)) + Traits::K[r] + W[r];
+				Word T2 = Traits::S0(a) + ((a & b) ^ (a & c) ^ (b & c));
+				h = g;
+				g = f;
+				f = e;
+				e = d + T1;
+				d = c;
+				c = b;
+				b = a;
+				a = T1 + T2;
+			}
+
+			hashes[0] += a;
+			hashes[1] += b;
+			hashes[2] += c;
+			hashes[3] += d;
+			hashes[4] += e;
+			hashes[5] += f;
+			hashes[6] += g;
+			hashes[7] += h;
+		}
+
+		std::array<Word, 8> hashes;
+		std::array<uint8_t, Traits::block_size> block{};
+		size_t block_length = 0;
+		uint64_t length_in_bytes = 0;
+	};
+
+	using SHA256 = Hasher<detail::SHA256Traits>;
+	using SHA512 = Hasher<detail::SHA512Traits>;
+
+	template <typename Traits>
+	constexpr std::array<uint8_t, Traits::digest_size> digest(std::string_view message)
+	{
+		Hasher<Traits> hasher;
+		hasher.update(message);
+		return hasher.final();
+	}
+
+	template <typename Traits>
+	constexpr std::array<uint8_t, Traits::digest_size> digest(const uint8_t* data, size_t length)
+	{
+		Hasher<Traits> hasher;
+		hasher.update(data, length);
+		return hasher.final();
+	}
+
+	constexpr std::array<uint8_t, 32> sha256(std::string_view message)
+	{
+		return digest<detail::SHA256Traits>(message);
+	}
+
+	constexpr std::array<uint8_t, 32> sha256(const uint8_t* data, size_t length)
+	{
+		return digest<detail::SHA256Traits>(data, length);
+	}
+
+	constexpr std::array<uint8_t, 64> sha512(std::string_view message)
+	{
+		return digest<detail::SHA512Traits>(message);
+	}
+
+	constexpr std::array<uint8_t, 64> sha512(const uint8_t* data, size_t length)
+	{
+		return digest<detail::SHA512Traits>(data, length);
+	}
+
+	//Lowercase hex with a terminating NUL, as sha256_to_hex and sha512_to_hex write it
+	template <size_t N>
+	constexpr std::array<char, 2 * N + 1> to_hex(const std::array<uint8_t, N>& digest)
+	{
+		constexpr std::string_view digits = "0123456789abcdef";
+		std::array<char, 2 * N + 1> hex{};
+
+		for(size_t i = 0; i < N; i++)
+		{
+			hex[2 * i] = digits[digest[i] >> 4];
+			hex[2 * i + 1] = digits[digest[i] & 15];
+		}
+		return hex;
+	}
+
+	//The first eight digest bytes, big-endian, usable as a switch label or a table index
+	template <size_t N>
+	constexpr uint64_t key64(const std::array<uint8_t, N>& digest)
+	{
+		uint64_t key = 0;
+
+		for(size_t i = 0; i < 8; i++)
+		{
+			key = (key << 8) | digest[i];
+		}
+		return key;
+	}
+}
+
+#endif
@@ -0,0 +1,692 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha2_async.hpp - C++20 coroutine hashing that overlaps reading with compression
+ *
+ *   Chunks are read on an EventLoop thread into a few recycled buffers, compressed in order on a
+ *   HashExecutor thread, and the digest comes back to the loop as the result of an awaitable Task:
+ *
+ *       sha2::EventLoop loop;
+ *       sha2::HashExecutor executor;
+ *       sha2::BufferPool pool(loop, 4, 1 << 16);
+ *       sha2::FdSource source(loop, socket);
+ *       auto digest = loop.run(sha2::hash_async<sha2::CSHA512>(loop, executor, pool, source));
+ *
+ *   Compression defaults to CSHA256, over sha256_update and its SHA-NI and AVX2 kernels, so the
+ *   program links the C library it overlaps with:
+ *
+ *       cc -O2 -c ../sha256/sha256*.c ../sha512/sha512*.c
+ *       c++ -std=c++20 -O2 -pthread program.cpp sha256*.o sha512*.o
+ *
+ *   Readers wait for readiness through epoll, so a slow socket or pipe never blocks the loop, and a
+ *   stream holding no buffer leaves them to the others. Any type with Digest, update(data, length)
+ *   and final() can stand in for the hasher; the byte-at-a-time constexpr sha2::Hasher works but is
+ *   meant for compile-time use.
+ *   All coroutines are expected to run on the loop thread, and a started Task to run to completion; the
+ *   loop, executor, pool and source must outlive it. cpp/sha2_selftest.cpp checks it against known answers.
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#ifndef SHA2_ASYNC_HPP
+#define SHA2_ASYNC_HPP
+#include "sha2.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <fcntl.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace sha2
+{
+	//Lazy coroutine result; it starts when awaited and resumes its awaiter when it finishes
+	template <typename T>
+	class Task
+	{
+	public:
+		struct promise_type
+		{
+			std::optional<T> value;
+			std::exception_ptr error;
+			std::coroutine_handle<> continuation;
+			bool started = false;
+
+			Task get_return_object()
+			{
+				return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+
+			std::suspend_always initial_suspend() noexcept
+			{
+				return {};
+			}
+
+			struct FinalAwaiter
+			{
+				bool await_ready() noexcept
+				{
+					return false;
+				}
+
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+				{
+					std::coroutine_handle<> continuation = handle.promise().continuation;
+					return continuation ? continuation : std::noop_coroutine();
+				}
+
+				void await_resume() noexcept
+				{
+				}
+			};
+
+			FinalAwaiter final_suspend() noexcept
+			{
+				return {};
+			}
+
+			void return_value(T result)
+			{
+				value = std::move(result);
+			}
+
+			void unhandled_exception()
+			{
+				error = std::current_exception();
+			}
+		};
+
+		explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle)
+		{
+		}
+
+		Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr))
+		{
+		}
+
+		Task(const Task&) = delete;
+		Task& operator=(const Task&) = delete;
+
+		//A coroutine suspended midway may have jobs queued or epoll waits armed against its frame, so a started
+		//Task has to run to completion; destroying it earlier terminates, as a joinable std::thread does
+		~Task()
+		{
+			if(handle)
+			{
+				if(handle.promise().started && !handle.done())
+				{
+					std::terminate();
+				}
+				handle.destroy();
+			}
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+		{
+			handle.promise().continuation = awaiter;
+			handle.promise().started = true;
+			return handle;
+		}
+
+		T await_resume()
+		{
+			return result();
+		}
+
+		void start()
+		{
+			handle.promise().started = true;
+			handle.resume();
+		}
+
+		bool done() const
+		{
+			return handle.done();
+		}
+
+		T result()
+		{
+			if(handle.promise().error)
+			{
+				std::rethrow_exception(handle.promise().error);
+			}
+			return std::move(*handle.promise().value);
+		}
+
+	private:
+		std::coroutine_handle<promise_type> handle;
+	};
+
+	//epoll for readiness plus an eventfd through which other threads hand coroutines back to this one
+	class EventLoop
+	{
+	public:
+		EventLoop() : epoll(epoll_create1(EPOLL_CLOEXEC)), wake(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+		{
+			epoll_event event{};
+
+			event.events = EPOLLIN;
+			event.data.ptr = nullptr;
+			if(epoll < 0 || wake < 0 || epoll_ctl(epoll, EPOLL_CTL_ADD, wake, &event) != 0)
+			{
+				int error = errno;
+				close_all();
+				throw std::system_error(error, std::generic_category(), "EventLoop");
+			}
+		}
+
+		EventLoop(const EventLoop&) = delete;
+		EventLoop& operator=(const EventLoop&) = delete;
+
+		~EventLoop()
+		{
+			close_all();
+		}
+
+		//Safe from any thread; the handle is resumed on the loop thread
+		void post(std::coroutine_handle<> handle)
+		{
+			uint64_t one = 1;
+
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				ready.push_back(handle);
+			}
+			while(write(wake, &one, sizeof(one)) < 0 && errno == EINTR)
+			{
+			}
+		}
+
+		//Suspends until fd is readable; resumes at once with the error if fd cannot be watched
+		auto readable(int fd)
+		{
+			struct Awaiter
+			{
+				EventLoop& loop;
+				int fd;
+				int error;
+
+				bool await_ready() const noexcept
+				{
+					return false;
+				}
+
+				bool await_suspend(std::coroutine_handle<> handle) noexcept
+				{
+					epoll_event event{};
+
+					event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+					event.data.ptr = handle.address();
+					if(epoll_ctl(loop.epoll, EPOLL_CTL_MOD, fd, &event) == 0 || (errno == ENOENT && epoll_ctl(loop.epoll, EPOLL_CTL_ADD, fd, &event) == 0))
+					{
+						return true;
+					}
+					error = errno;
+					return false;
+				}
+
+				int await_resume() const noexcept
+				{
+					return error;
+				}
+			};
+
+			return Awaiter{ *this, fd, 0 };
+		}
+
+		void forget(int fd)
+		{
+			epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+		}
+
+		//Drives task and whatever it waits on until it finishes, then returns its result
+		template <typename T>
+		T run(Task<T> task)
+		{
+			task.start();
+			while(!task.done())
+			{
+				step();
+			}
+			return task.result();
+		}
+
+	private:
+		void step()
+		{
+			std::deque<std::coroutine_handle<>> resumable;
+			epoll_event events[64];
+
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				resumable.swap(ready);
+			}
+			if(!resumable.empty())
+			{
+				for(std::coroutine_handle<> handle : resumable)
+				{
+					handle.resume();
+				}
+				return;
+			}
+
+			int count = epoll_wait(epoll, events, 64, -1);
+			for(int i = 0; i < count; i++)
+			{
+				if(events[i].data.ptr == nullptr)
+				{
+					uint64_t posted;
+					while(read(wake, &posted, sizeof(posted)) < 0 && errno == EINTR)
+					{
+					}
+				}
+				else
+				{
+					std::coroutine_handle<>::from_address(events[i].data.ptr).resume();
+				}
+			}
+		}
+
+		void close_all()
+		{
+			if(wake >= 0)
+			{
+				close(wake);
+			}
+			if(epoll >= 0)
+			{
+				close(epoll);
+			}
+		}
+
+		int epoll;
+		int wake;
+		std::mutex lock;
+		std::deque<std::coroutine_handle<>> ready;
+	};
+
+	//Where chunks come from; read returns the bytes read, 0 at the end, or a negative errno
+	class ChunkSource
+	{
+	public:
+		virtual ~ChunkSource() = default;
+		virtual Task<ssize_t> read(uint8_t* data, size_t size) = 0;
+	};
+
+	//A file, pipe or socket; the descriptor is switched to non-blocking and stays owned by the caller
+	class FdSource : public ChunkSource
+	{
+	public:
+		FdSource(EventLoop& loop, int fd) : loop(loop), fd(fd)
+		{
+			int flags = fcntl(fd, F_GETFL);
+
+			if(flags >= 0)
+			{
+				fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+			}
+		}
+
+		~FdSource() override
+		{
+			loop.forget(fd);
+		}
+
+		Task<ssize_t> read(uint8_t* data, size_t size) override
+		{
+			for(;;)
+			{
+				ssize_t n = ::read(fd, data, size);
+
+				if(n >= 0)
+				{
+					co_return n;
+				}
+				if(errno == EINTR)
+				{
+					continue;
+				}
+				if(errno != EAGAIN && errno != EWOULDBLOCK)
+				{
+					co_return -errno;
+				}
+
+				int error = co_await loop.readable(fd);
+				if(error != 0)
+				{
+					co_return -error;
+				}
+			}
+		}
+
+	private:
+		EventLoop& loop;
+		int fd;
+	};
+
+	//Local stand-in for a reader: hands out a buffer in chunks of at most chunk bytes
+	class MemorySource : public ChunkSource
+	{
+	public:
+		MemorySource(const uint8_t* data, size_t length, size_t chunk) : data(data), length(length), chunk(chunk)
+		{
+		}
+
+		Task<ssize_t> read(uint8_t* output, size_t size) override
+		{
+			size_t n = length - offset;
+
+			n = n < size ? n : size;
+			n = n < chunk ? n : chunk;
+			std::copy(data + offset, data + offset + n, output);
+			offset += n;
+			co_return static_cast<ssize_t>(n);
+		}
+
+	private:
+		const uint8_t* data;
+		size_t length;
+		size_t chunk;
+		size_t offset = 0;
+	};
+
+	//The dedicated compression thread; jobs run one at a time in submission order
+	class HashExecutor
+	{
+	public:
+		HashExecutor() : worker([this] { work(); })
+		{
+		}
+
+		HashExecutor(const HashExecutor&) = delete;
+		HashExecutor& operator=(const HashExecutor&) = delete;
+
+		~HashExecutor()
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				stopping = true;
+			}
+			changed.notify_one();
+			worker.join();
+		}
+
+		void submit(std::function<void()> job)
+		{
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				jobs.push_back(std::move(job));
+			}
+			changed.notify_one();
+		}
+
+		//Runs job after everything submitted before it, then resumes the awaiting coroutine on loop
+		auto run(EventLoop& loop, std::function<void()> job)
+		{
+			struct Awaiter
+			{
+				HashExecutor& executor;
+				EventLoop& loop;
+				std::function<void()> job;
+
+				bool await_ready() const noexcept
+				{
+					return false;
+				}
+
+				void await_suspend(std::coroutine_handle<> handle)
+				{
+					executor.submit([this, handle] {
+						job();
+						loop.post(handle);
+					});
+				}
+
+				void await_resume() const noexcept
+				{
+				}
+			};
+
+			return Awaiter{ *this, loop, std::move(job) };
+		}
+
+	private:
+		void work()
+		{
+			for(;;)
+			{
+				std::function<void()> job;
+
+				{
+					std::unique_lock<std::mutex> guard(lock);
+					changed.wait(guard, [this] { return stopping || !jobs.empty(); });
+					if(jobs.empty())
+					{
+						return;
+					}
+					job = std::move(jobs.front());
+					jobs.pop_front();
+				}
+				job();
+			}
+		}
+
+		std::mutex lock;
+		std::condition_variable changed;
+		std::deque<std::function<void()>> jobs;
+		bool stopping = false;
+		std::thread worker;
+	};
+
+	//A fixed set of buffers allocated once; acquire suspends until the executor hands one back
+	class BufferPool
+	{
+	public:
+		BufferPool(EventLoop& loop, size_t count, size_t size) : loop(loop), storage(new uint8_t[count * size]), size(size)
+		{
+			for(size_t i = 0; i < count; i++)
+			{
+				available.push_back(storage.get() + i * size);
+			}
+		}
+
+		struct Acquire
+		{
+			BufferPool& pool;
+			std::coroutine_handle<> handle;
+			uint8_t* buffer;
+
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+
+			bool await_suspend(std::coroutine_handle<> awaiting)
+			{
+				std::lock_guard<std::mutex> guard(pool.lock);
+
+				if(!pool.available.empty())
+				{
+					buffer = pool.available.back();
+					pool.available.pop_back();
+					return false;
+				}
+				handle = awaiting;
+				pool.waiting.push_back(this);
+				return true;
+			}
+
+			uint8_t* await_resume() const noexcept
+			{
+				return buffer;
+			}
+		};
+
+		size_t buffer_size() const
+		{
+			return size;
+		}
+
+		Acquire acquire()
+		{
+			return Acquire{ *this, nullptr, nullptr };
+		}
+
+		//Safe from any thread; a waiting coroutine gets the buffer directly and resumes on the loop
+		void release(uint8_t* buffer)
+		{
+			std::unique_lock<std::mutex> guard(lock);
+
+			if(waiting.empty())
+			{
+				available.push_back(buffer);
+				return;
+			}
+
+			Acquire* awaiter = waiting.front();
+			waiting.pop_front();
+			awaiter->buffer = buffer;
+			std::coroutine_handle<> handle = awaiter->handle;
+			guard.unlock();
+			loop.post(handle);
+		}
+
+	private:
+		EventLoop& loop;
+		std::unique_ptr<uint8_t[]> storage;
+		size_t size;
+		std::mutex lock;
+		std::vector<uint8_t*> available;
+		std::deque<Acquire*> waiting;
+	};
+
+	//The C contexts of sha256.h and sha512.h, repeated here because the two headers cannot share a translation unit
+	namespace c
+	{
+		struct SHA256Context
+		{
+			uint64_t length_in_bits;
+			uint8_t block[64];
+			uint8_t block_length;
+			uint32_t hashes[8];
+		};
+
+		struct SHA512Context
+		{
+			unsigned __int128 length_in_bits;
+			uint8_t block[128];
+			uint8_t block_length;
+			uint64_t hashes[8];
+		};
+
+		extern "C"
+		{
+			void sha256_init(SHA256Context* ctx);
+			void sha256_update(SHA256Context* ctx, const void* data, size_t length);
+			void sha256_final(SHA256Context* ctx, uint8_t digest[32]);
+			void sha512_init(SHA512Context* ctx);
+			void sha512_update(SHA512Context* ctx, const void* data, size_t length);
+			void sha512_final(SHA512Context* ctx, uint8_t digest[64]);
+		}
+	}
+
+	//Run-time hasher on the C library, which picks its fastest compression backend
+	template <typename Context, size_t N, void (*Init)(Context*), void (*Update)(Context*, const void*, size_t), void (*Final)(Context*, uint8_t*)>
+	class CHasher
+	{
+	public:
+		using Digest = std::array<uint8_t, N>;
+
+		CHasher()
+		{
+			Init(&ctx);
+		}
+
+		void update(const uint8_t* data, size_t length)
+		{
+			Update(&ctx, data, length);
+		}
+
+		Digest final()
+		{
+			Digest digest;
+
+			Final(&ctx, digest.data());
+			return digest;
+		}
+
+	private:
+		Context ctx;
+	};
+
+	using CSHA256 = CHasher<c::SHA256Context, 32, c::sha256_init, c::sha256_update, c::sha256_final>;
+	using CSHA512 = CHasher<c::SHA512Context, 64, c::sha512_init, c::sha512_update, c::sha512_final>;
+
+	//Reads source to the end through pool, compressing each chunk on executor while the next one is read.
+	//Queued jobs use the hasher in this frame and pool, so every exit, including a read error (thrown as
+	//std::system_error) or an exception from source, first waits for the jobs already submitted.
+	template <typename Hasher = CSHA256>
+	Task<typename Hasher::Digest> hash_async(EventLoop& loop, HashExecutor& executor, BufferPool& pool, ChunkSource& source)
+	{
+		Hasher hasher;
+		typename Hasher::Digest digest{};
+
+		for(;;)
+		{
+			uint8_t* buffer = co_await pool.acquire();
+			std::exception_ptr failure;
+			ssize_t n = 0;
+
+			try
+			{
+				n = co_await source.read(buffer, pool.buffer_size());
+			}
+			catch(...)
+			{
+				failure = std::current_exception();
+			}
+
+			if(failure || n <= 0)
+			{
+				pool.release(buffer);
+				co_await executor.run(loop, [&] {
+					if(!failure && n == 0)
+					{
+						digest = hasher.final();
+					}
+				});
+				if(failure)
+				{
+					std::rethrow_exception(failure);
+				}
+				if(n < 0)
+				{
+					throw std::system_error(static_cast<int>(-n), std::generic_category(), "hash_async");
+				}
+				co_return digest;
+			}
+
+			executor.submit([&hasher, &pool, buffer, n] {
+				hasher.update(buffer, static_cast<size_t>(n));
+				pool.release(buffer);
+			});
+		}
+	}
+}
+
+#endif
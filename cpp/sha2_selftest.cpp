@@ -0,0 +1,290 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha2_selftest.cpp - Known-answer tests for sha2.hpp and the coroutine pipeline of sha2_async.hpp
+ *
+ *       cc -O2 -c ../sha256/sha256*.c ../sha512/sha512*.c
+ *       c++ -std=c++20 -O2 -pthread sha2_selftest.cpp sha256*.o sha512*.o -o sha2_selftest
+ *
+ *   The constexpr hashers are checked at compile time around the padding cutoffs.
+ *   Every FIPS 180 example and padding-boundary message of the C self-tests is hashed directly and
+ *   through hash_async, with both the C-backed and the constexpr hashers, from memory in several chunk
+ *   sizes, from a pipe fed by another thread and from a regular file; read errors and throwing sources
+ *   must surface without losing pool buffers.
+ *   Failures are printed and the exit status is 1.
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include "sha2_async.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+struct KnownAnswer
+{
+	std::string message;
+	const char* digest;
+};
+
+static const char* const million_a_256 = "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0";
+static const char* const million_a_512 = "e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973ebde0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b";
+
+//Byte i = i % 251, as in sha256_selftest.c and sha512_selftest.c
+static std::string pattern(size_t length)
+{
+	std::string message(length, '\0');
+
+	for(size_t i = 0; i < length; i++)
+	{
+		message[i] = static_cast<char>(i % 251);
+	}
+	return message;
+}
+
+static std::vector<KnownAnswer> sha256_answers()
+{
+	return {
+		{ "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+		{ "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+		{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+		{ "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+		{ std::string(1000000, 'a'), million_a_256 },
+		{ pattern(1), "6e340b9cffb37a989ca544e6bb780a2c78901d3fb33738768511a30617afa01d" },
+		{ pattern(55), "463eb28e72f82e0a96c0a4cc53690c571281131f672aa229e0d45ae59b598b59" },
+		{ pattern(56), "da2ae4d6b36748f2a318f23e7ab1dfdf45acdc9d049bd80e59de82a60895f562" },
+		{ pattern(57), "2fe741af801cc238602ac0ec6a7b0c3a8a87c7fc7d7f02a3fe03d1c12eac4d8f" },
+		{ pattern(63), "29af2686fd53374a36b0846694cc342177e428d1647515f078784d69cdb9e488" },
+		{ pattern(64), "fdeab9acf3710362bd2658cdc9a29e8f9c757fcf9811603a8c447cd1d9151108" },
+		{ pattern(65), "4bfd2c8b6f1eec7a2afeb48b934ee4b2694182027e6d0fc075074f2fabb31781" },
+		{ pattern(119), "da18797ed7c3a777f0847f429724a2d8cd5138e6ed2895c3fa1a6d39d18f7ec6" },
+		{ pattern(120), "f52b23db1fbb6ded89ef42a23ce0c8922c45f25c50b568a93bf1c075420bbb7c" },
+		{ pattern(127), "92ca0fa6651ee2f97b884b7246a562fa71250fedefe5ebf270d31c546bfea976" },
+		{ pattern(128), "471fb943aa23c511f6f72f8d1652d9c880cfa392ad80503120547703e56a2be5" },
+		{ pattern(1000), "4e4c294b331f7a2099a379bec34b9f9fc03dc46ab465d998f4d683da53487e6d" }
+	};
+}
+
+static std::vector<KnownAnswer> sha512_answers()
+{
+	return {
+		{ "", "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e" },
+		{ "abc", "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f" },
+		{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "204a8fc6dda82f0a0ced7beb8e08a41657c16ef468b228a8279be331a703c33596fd15c13b1b07f9aa1d3bea57789ca031ad85c7a71dd70354ec631238ca3445" },
+		{ "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909" },
+		{ std::string(1000000, 'a'), million_a_512 },
+		{ pattern(1), "b8244d028981d693af7b456af8efa4cad63d282e19ff14942c246e50d9351d22704a802a71c3580b6370de4ceb293c324a8423342557d4e5c38438f0e36910ee" },
+		{ pattern(111), "a1a111449b198d9b1f538bad7f3fc1022b3a5b1a5e90a0bc860de8512746cbc31599e6c834de3a3235327af0b51ff57bf7acf1974a73014d9c3953812edc7c8d" },
+		{ pattern(112), "c5fbd731d19d2ae1180f001be72c2c1aaba1d7b094b3748880e24593b8e117a750e11c1bd867cc2f96dace8c8b74abd2d5c4f236be444e77d30d1916174070b9" },
+		{ pattern(113), "61b2e77db697dfe5571fff3ed06bd60c41e1e7b7c08a80de01cb16526d9a9a52d690dfbe792278a60f6e2b4c57a97c729773f26e258d2393890c985d645f6715" },
+		{ pattern(127), "eab89674feaa34e27aebeeff3c0a4d70070bb872d5e9f186cf1dbbdee517b6e35724d629ff025a5b07185e911ada7e3c8acf830aa0e4f71777bd2d44f504f7f0" },
+		{ pattern(128), "1dffd5e3adb71d45d2245939665521ae001a317a03720a45732ba1900ca3b8351fc5c9b4ca513eba6f80bc7b1d1fdad4abd13491cb824d61b08d8c0e1561b3f7" },
+		{ pattern(129), "1d9da57fbbdab09afb3506ab2d223d06109d65c1c8ad197f50138f714bc4c3f2fe5787922639c680acad1c651f955990425954ce2cba0c5cc83f2667d878eb0f" },
+		{ pattern(239), "cb4c7fd522756d5781ad3a4f590a1d862906b960e7720136cb3fb36b563caa1ea5689134291fa79c80ccc2b4092b41df32ebdcb36dbe79db483440228c1622a8" },
+		{ pattern(240), "6c48466c9f6c07e4ab762c696b7eeb35cfe236fca73683e5fab873ac3489b4d2eb3d7afcce7e8165dbbf37aded3b5b0c889c0b7e0f1790a8330d8677429d91a5" },
+		{ pattern(255), "e9746a5516961da1fdc8e6c59350cd147b7d80c120cc7ed621399faeb2462c28f34217a13009a8e6a721f538356db9a9b64d9a5412e0fd07d24cac1315d95548" },
+		{ pattern(256), "7ff1cd1e9773a4b7ba1f40e642db0d879bd5f6cc151a7d3401a0bc7778b8270c108b530fb195f2383f4cec8cf05778e6af4db56811673371674cec1524488f83" },
+		{ pattern(1000), "5096498d96f50f9a137c4db5b8b0cd38383ad55350fb5a98805fedc31fa1262f1f0cf4d6f12d7ecd8dedd933a4c9126344fe22e937a8ad35fdeae1e876ae698b" }
+	};
+}
+
+//Digest of the length-byte pattern message against the expected hex, at compile time
+template <typename Hasher>
+constexpr bool pattern_matches(size_t length, std::string_view expected)
+{
+	Hasher hasher;
+
+	for(size_t i = 0; i < length; i++)
+	{
+		uint8_t byte = static_cast<uint8_t>(i % 251);
+		hasher.update(&byte, 1);
+	}
+
+	auto hex = sha2::to_hex(hasher.final());
+	return expected == std::string_view(hex.data(), hex.size() - 1);
+}
+
+//Known answers around the padding cutoffs, so a constexpr regression fails this file's compilation
+static_assert(sha2::key64(sha2::sha256("abc")) == 0xba7816bf8f01cfeaULL, "SHA256 abc");
+static_assert(pattern_matches<sha2::SHA256>(55, "463eb28e72f82e0a96c0a4cc53690c571281131f672aa229e0d45ae59b598b59"), "SHA256 55 bytes");
+static_assert(pattern_matches<sha2::SHA256>(56, "da2ae4d6b36748f2a318f23e7ab1dfdf45acdc9d049bd80e59de82a60895f562"), "SHA256 56 bytes");
+static_assert(pattern_matches<sha2::SHA256>(63, "29af2686fd53374a36b0846694cc342177e428d1647515f078784d69cdb9e488"), "SHA256 63 bytes");
+static_assert(pattern_matches<sha2::SHA256>(64, "fdeab9acf3710362bd2658cdc9a29e8f9c757fcf9811603a8c447cd1d9151108"), "SHA256 64 bytes");
+static_assert(sha2::key64(sha2::sha512("abc")) == 0xddaf35a193617abaULL, "SHA512 abc");
+static_assert(pattern_matches<sha2::SHA512>(111, "a1a111449b198d9b1f538bad7f3fc1022b3a5b1a5e90a0bc860de8512746cbc31599e6c834de3a3235327af0b51ff57bf7acf1974a73014d9c3953812edc7c8d"), "SHA512 111 bytes");
+static_assert(pattern_matches<sha2::SHA512>(112, "c5fbd731d19d2ae1180f001be72c2c1aaba1d7b094b3748880e24593b8e117a750e11c1bd867cc2f96dace8c8b74abd2d5c4f236be444e77d30d1916174070b9"), "SHA512 112 bytes");
+static_assert(pattern_matches<sha2::SHA512>(127, "eab89674feaa34e27aebeeff3c0a4d70070bb872d5e9f186cf1dbbdee517b6e35724d629ff025a5b07185e911ada7e3c8acf830aa0e4f71777bd2d44f504f7f0"), "SHA512 127 bytes");
+static_assert(pattern_matches<sha2::SHA512>(128, "1dffd5e3adb71d45d2245939665521ae001a317a03720a45732ba1900ca3b8351fc5c9b4ca513eba6f80bc7b1d1fdad4abd13491cb824d61b08d8c0e1561b3f7"), "SHA512 128 bytes");
+
+static int failures = 0;
+
+template <size_t N>
+static void check(const char* test, const char* algorithm, size_t length, const std::array<uint8_t, N>& digest, const char* expected)
+{
+	if(std::strcmp(sha2::to_hex(digest).data(), expected) != 0)
+	{
+		std::printf("FAILED test=%s algorithm=%s length=%zu\n", test, algorithm, length);
+		failures++;
+	}
+}
+
+//Its own type, so that a std::system_error from the pipeline cannot pass for it
+class SourceFailure : public std::exception
+{
+};
+
+//Fails every read, to stand in for a source that throws instead of returning an errno
+class ThrowingSource : public sha2::ChunkSource
+{
+public:
+	sha2::Task<ssize_t> read(uint8_t*, size_t) override
+	{
+		throw SourceFailure();
+		co_return 0;
+	}
+};
+
+template <typename Hasher>
+static void run_tests(const char* algorithm, const std::vector<KnownAnswer>& answers)
+{
+	sha2::EventLoop loop;
+	sha2::HashExecutor executor;
+	sha2::BufferPool pool(loop, 2, 4096);
+
+	for(const KnownAnswer& answer : answers)
+	{
+		const uint8_t* data = reinterpret_cast<const uint8_t *>(answer.message.data());
+		size_t length = answer.message.size();
+
+		Hasher hasher;
+		hasher.update(data, length);
+		check("direct", algorithm, length, hasher.final(), answer.digest);
+
+		//Single bytes through the pipeline are slow for the million-byte message, so it starts at 7
+		for(size_t chunk : { 1, 7, 64, 1000, 4096 })
+		{
+			if(chunk == 1 && length > 4096)
+			{
+				continue;
+			}
+			sha2::MemorySource source(data, length, chunk);
+			check("memory", algorithm, length, loop.run(sha2::hash_async<Hasher>(loop, executor, pool, source)), answer.digest);
+		}
+
+		//A writer thread feeds a pipe in uneven pieces with pauses, so reads meet EAGAIN and wait on epoll
+		int fds[2];
+		if(pipe(fds) != 0)
+		{
+			std::printf("FAILED test=pipe algorithm=%s: no pipe\n", algorithm);
+			failures++;
+			continue;
+		}
+		std::thread writer([&] {
+			size_t written = 0;
+			for(size_t piece = 1; written < length; piece = piece * 3 + 1)
+			{
+				size_t n = length - written < piece ? length - written : piece;
+				ssize_t k = write(fds[1], data + written, n);
+				if(k < 0)
+				{
+					break;
+				}
+				written += static_cast<size_t>(k);
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			}
+			close(fds[1]);
+		});
+		{
+			sha2::FdSource source(loop, fds[0]);
+			check("pipe", algorithm, length, loop.run(sha2::hash_async<Hasher>(loop, executor, pool, source)), answer.digest);
+		}
+		writer.join();
+		close(fds[0]);
+
+		FILE* file = tmpfile();
+		if(file != nullptr && fwrite(data, 1, length, file) == length && fflush(file) == 0 && fseek(file, 0, SEEK_SET) == 0)
+		{
+			sha2::FdSource source(loop, fileno(file));
+			check("file", algorithm, length, loop.run(sha2::hash_async<Hasher>(loop, executor, pool, source)), answer.digest);
+		}
+		else
+		{
+			std::printf("FAILED test=file algorithm=%s: no temporary file\n", algorithm);
+			failures++;
+		}
+		if(file != nullptr)
+		{
+			fclose(file);
+		}
+	}
+
+	//Errors repeated more times than the pool has buffers: a buffer lost on the error path would hang the last hash
+	for(int round = 0; round < 4; round++)
+	{
+		int fds[2];
+
+		if(pipe(fds) != 0)
+		{
+			failures++;
+			continue;
+		}
+		close(fds[0]);
+		close(fds[1]);
+
+		sha2::FdSource closed(loop, fds[0]);
+		try
+		{
+			loop.run(sha2::hash_async<Hasher>(loop, executor, pool, closed));
+			std::printf("FAILED test=read_error algorithm=%s: no exception\n", algorithm);
+			failures++;
+		}
+		catch(const std::system_error& error)
+		{
+			if(error.code().value() != EBADF)
+			{
+				std::printf("FAILED test=read_error algorithm=%s: %s\n", algorithm, error.what());
+				failures++;
+			}
+		}
+
+		ThrowingSource throwing;
+		try
+		{
+			loop.run(sha2::hash_async<Hasher>(loop, executor, pool, throwing));
+			std::printf("FAILED test=throwing_source algorithm=%s: no exception\n", algorithm);
+			failures++;
+		}
+		catch(const SourceFailure&)
+		{
+		}
+	}
+
+	const KnownAnswer& abc = answers[1];
+	sha2::MemorySource after(reinterpret_cast<const uint8_t *>(abc.message.data()), abc.message.size(), 1);
+	check("after_errors", algorithm, abc.message.size(), loop.run(sha2::hash_async<Hasher>(loop, executor, pool, after)), abc.digest);
+}
+
+int main()
+{
+	//A lost buffer shows up as a hang rather than a wrong answer
+	alarm(120);
+
+	run_tests<sha2::CSHA256>("sha256", sha256_answers());
+	run_tests<sha2::CSHA512>("sha512", sha512_answers());
+	run_tests<sha2::SHA256>("constexpr_sha256", sha256_answers());
+	run_tests<sha2::SHA512>("constexpr_sha512", sha512_answers());
+
+	//Without a hasher argument the pipeline hashes SHA256 on the C library
+	sha2::EventLoop loop;
+	sha2::HashExecutor executor;
+	sha2::BufferPool pool(loop, 2, 4096);
+	sha2::MemorySource source(reinterpret_cast<const uint8_t *>("abc"), 3, 3);
+	check("default", "sha256", 3, loop.run(sha2::hash_async(loop, executor, pool, source)), sha256_answers()[1].digest);
+
+	std::printf("%d failures\n", failures);
+	return failures > 0;
+}
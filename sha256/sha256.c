@@ -4,15 +4,95 @@
  *   
  *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
  */
-#include "sha256.h"
+#include "sha256_stats.h"
 
-static void init_ctx(Context* ctx, const char* message)
+static void compute_hashes_scalar(uint32_t hashes[8], const uint8_t* blocks, uint64_t number_of_blocks);
+
+#if defined(__x86_64__) || defined(__i386__)
+void sha256_compress_shani(uint32_t hashes[8], const uint8_t* blocks, uint64_t number_of_blocks);
+#endif
+
+static void (*compute_hashes)(uint32_t hashes[8], const uint8_t* blocks, uint64_t number_of_blocks) = compute_hashes_scalar;
+static SHA256Backend selected_backend = SHA256_BACKEND_SCALAR;
+
+static int backend_supported(SHA256Backend backend)
+{
+	switch(backend)
+	{
+		case SHA256_BACKEND_SCALAR:
+			return 1;
+#if defined(__x86_64__) || defined(__i386__)
+		case SHA256_BACKEND_SHANI:
+			return __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+#endif
+		default:
+			return 0;
+	}
+}
+
+int sha256_set_backend(SHA256Backend backend)
+{
+	if(backend == SHA256_BACKEND_AUTO)
+	{
+		backend = backend_supported(SHA256_BACKEND_SHANI) ? SHA256_BACKEND_SHANI : SHA256_BACKEND_SCALAR;
+	}
+
+	if(!backend_supported(backend))
+	{
+		return -1;
+	}
+
+	switch(backend)
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		case SHA256_BACKEND_SHANI:
+			compute_hashes = sha256_compress_shani;
+			break;
+#endif
+		default:
+			compute_hashes = compute_hashes_scalar;
+			break;
+	}
+
+	selected_backend = backend;
+	return 0;
+}
+
+SHA256Backend sha256_get_backend(void)
+{
+	return selected_backend;
+}
+
+//Runs once at load time; SHA256_BACKEND=scalar|shani in the environment overrides the CPUID choice
+__attribute__((constructor)) static void select_backend(void)
 {
-	ctx->message = message;
-	ctx->length_in_bits = strlen(message) * 8;
-	ctx->k = (447 - ctx->length_in_bits) % 512;
-	ctx->padded_length_in_bits = ctx->length_in_bits + 1 + ctx->k + 64;
-	ctx->padded = (uint8_t *) malloc(sizeof(uint8_t) * (ctx->padded_length_in_bits)/8);
+	const char* forced = getenv("SHA256_BACKEND");
+
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+#endif
+
+	if(forced != NULL && strcmp(forced, "scalar") == 0 && sha256_set_backend(SHA256_BACKEND_SCALAR) == 0)
+	{
+		return;
+	}
+	if(forced != NULL && strcmp(forced, "shani") == 0 && sha256_set_backend(SHA256_BACKEND_SHANI) == 0)
+	{
+		return;
+	}
+
+	sha256_set_backend(SHA256_BACKEND_AUTO);
+}
+
+void sha256_compress(uint32_t hashes[8], const uint8_t* blocks, uint64_t number_of_blocks)
+{
+	compute_hashes(hashes, blocks, number_of_blocks);
+}
+
+void sha256_init(Context* ctx)
+{
+	ctx->length_in_bits = 0;
+	ctx->block_length = 0;
 	ctx->hashes[0] = 0x6a09e667;
 	ctx->hashes[1] = 0xbb67ae85;
 	ctx->hashes[2] = 0x3c6ef372;
@@ -26,72 +106,71 @@ static void init_ctx(Context* ctx, const char* message)
 
 static void pad_ctx(Context* ctx)
 {
-	uint64_t length = ctx->length_in_bits / 8;
-	uint64_t padded_length = ctx->padded_length_in_bits / 8;
+	uint8_t length = ctx->block_length;
 
-	for(size_t i = 0; i < length; i++)
-	{
-		*(ctx->padded + i) = ctx->message[i];
-	}
-	
-	*(ctx->padded + length) = 128;
+	*(ctx->block + length) = 128;
+	length++;
 
-	for(size_t i = 0; i < (ctx->k - 7) / 8; i++)
+	if(length > 56)
 	{
-		*(ctx->padded + length + 1 + i) = 0;
+		memset(ctx->block + length, 0, 64 - length);
+		compute_hashes(ctx->hashes, ctx->block, 1);
+		length = 0;
 	}
 
+	memset(ctx->block + length, 0, 56 - length);
 
-	
-	*(ctx->padded + padded_length - 8) = (uint8_t) ((ctx->length_in_bits & mask(63)) >> 56); 	
-	*(ctx->padded + padded_length - 7) = (uint8_t) ((ctx->length_in_bits & mask(55)) >> 48); 	
-	*(ctx->padded + padded_length - 6) = (uint8_t) ((ctx->length_in_bits & mask(47)) >> 40); 	
-	*(ctx->padded + padded_length - 5) = (uint8_t) ((ctx->length_in_bits & mask(39)) >> 32); 	
-	*(ctx->padded + padded_length - 4) = (uint8_t) ((ctx->length_in_bits & mask(31)) >> 24); 	
-	*(ctx->padded + padded_length - 3) = (uint8_t) ((ctx->length_in_bits & mask(23)) >> 16); 	
-	*(ctx->padded + padded_length - 2) = (uint8_t) ((ctx->length_in_bits & mask(15)) >> 8); 	
-	*(ctx->padded + padded_length - 1) = (uint8_t) ((ctx->length_in_bits & mask(7))); 	
+	*(ctx->block + 56) = (uint8_t) ((ctx->length_in_bits & mask(63)) >> 56); 	
+	*(ctx->block + 57) = (uint8_t) ((ctx->length_in_bits & mask(55)) >> 48); 	
+	*(ctx->block + 58) = (uint8_t) ((ctx->length_in_bits & mask(47)) >> 40); 	
+	*(ctx->block + 59) = (uint8_t) ((ctx->length_in_bits & mask(39)) >> 32); 	
+	*(ctx->block + 60) = (uint8_t) ((ctx->length_in_bits & mask(31)) >> 24); 	
+	*(ctx->block + 61) = (uint8_t) ((ctx->length_in_bits & mask(23)) >> 16); 	
+	*(ctx->block + 62) = (uint8_t) ((ctx->length_in_bits & mask(15)) >> 8); 	
+	*(ctx->block + 63) = (uint8_t) ((ctx->length_in_bits & mask(7))); 	
 
+	compute_hashes(ctx->hashes, ctx->block, 1);
+	ctx->block_length = 0;
 }
 
-static void compute_hashes(Context* ctx)
+static void compute_hashes_scalar(uint32_t hashes[8], const uint8_t* blocks, uint64_t number_of_blocks)
 {
-	uint64_t number_of_blocks = ctx->padded_length_in_bits / 512;
+	STATS_BLOCKS(SHA256_KERNEL_SCALAR, number_of_blocks);
 
 	for(uint64_t i = 0; i < number_of_blocks; i++)
 	{
 		uint32_t W[64];
 
-		W[0] = (((uint32_t) *(ctx->padded + 64 * i)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 1)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 2)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 3)));
-		W[1] = (((uint32_t) *(ctx->padded + 64 * i + 4)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 5)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 6)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 7)));
-		W[2] = (((uint32_t) *(ctx->padded + 64 * i + 8)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 9)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 10)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 11)));
-		W[3] = (((uint32_t) *(ctx->padded + 64 * i + 12)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 13)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 14)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 15)));
-		W[4] = (((uint32_t) *(ctx->padded + 64 * i + 16)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 17)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 18)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 19)));
-		W[5] = (((uint32_t) *(ctx->padded + 64 * i + 20)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 21)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 22)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 23)));
-		W[6] = (((uint32_t) *(ctx->padded + 64 * i + 24)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 25)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 26)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 27)));
-	    W[7] = (((uint32_t) *(ctx->padded + 64 * i + 28)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 29)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 30)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 31)));
-		W[8] = (((uint32_t) *(ctx->padded + 64 * i + 32)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 33)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 34)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 35)));
-		W[9] = (((uint32_t) *(ctx->padded + 64 * i + 36)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 37)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 38)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 39)));
-		W[10] = (((uint32_t) *(ctx->padded + 64 * i + 40)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 41)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 42)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 43)));
-		W[11] = (((uint32_t) *(ctx->padded + 64 * i + 44)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 45)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 46)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 47)));
-		W[12] = (((uint32_t) *(ctx->padded + 64 * i + 48)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 49)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 50)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 51)));
-		W[13] = (((uint32_t) *(ctx->padded + 64 * i + 52)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 53)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 54)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 55)));
-		W[14] = (((uint32_t) *(ctx->padded + 64 * i + 56)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 57)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 58)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 59)));
-	    W[15] = (((uint32_t) *(ctx->padded + 64 * i + 60)) << 24) | (((uint32_t) *(ctx->padded + 64 * i + 61)) << 16) | (((uint32_t) *(ctx->padded + 64 * i + 62)) << 8) | (((uint32_t) *(ctx->padded + 64 * i + 63)));
+		W[0] = (((uint32_t) *(blocks + 64 * i)) << 24) | (((uint32_t) *(blocks + 64 * i + 1)) << 16) | (((uint32_t) *(blocks + 64 * i + 2)) << 8) | (((uint32_t) *(blocks + 64 * i + 3)));
+		W[1] = (((uint32_t) *(blocks + 64 * i + 4)) << 24) | (((uint32_t) *(blocks + 64 * i + 5)) << 16) | (((uint32_t) *(blocks + 64 * i + 6)) << 8) | (((uint32_t) *(blocks + 64 * i + 7)));
+		W[2] = (((uint32_t) *(blocks + 64 * i + 8)) << 24) | (((uint32_t) *(blocks + 64 * i + 9)) << 16) | (((uint32_t) *(blocks + 64 * i + 10)) << 8) | (((uint32_t) *(blocks + 64 * i + 11)));
+		W[3] = (((uint32_t) *(blocks + 64 * i + 12)) << 24) | (((uint32_t) *(blocks + 64 * i + 13)) << 16) | (((uint32_t) *(blocks + 64 * i + 14)) << 8) | (((uint32_t) *(blocks + 64 * i + 15)));
+		W[4] = (((uint32_t) *(blocks + 64 * i + 16)) << 24) | (((uint32_t) *(blocks + 64 * i + 17)) << 16) | (((uint32_t) *(blocks + 64 * i + 18)) << 8) | (((uint32_t) *(blocks + 64 * i + 19)));
+		W[5] = (((uint32_t) *(blocks + 64 * i + 20)) << 24) | (((uint32_t) *(blocks + 64 * i + 21)) << 16) | (((uint32_t) *(blocks + 64 * i + 22)) << 8) | (((uint32_t) *(blocks + 64 * i + 23)));
+		W[6] = (((uint32_t) *(blocks + 64 * i + 24)) << 24) | (((uint32_t) *(blocks + 64 * i + 25)) << 16) | (((uint32_t) *(blocks + 64 * i + 26)) << 8) | (((uint32_t) *(blocks + 64 * i + 27)));
+	    W[7] = (((uint32_t) *(blocks + 64 * i + 28)) << 24) | (((uint32_t) *(blocks + 64 * i + 29)) << 16) | (((uint32_t) *(blocks + 64 * i + 30)) << 8) | (((uint32_t) *(blocks + 64 * i + 31)));
+		W[8] = (((uint32_t) *(blocks + 64 * i + 32)) << 24) | (((uint32_t) *(blocks + 64 * i + 33)) << 16) | (((uint32_t) *(blocks + 64 * i + 34)) << 8) | (((uint32_t) *(blocks + 64 * i + 35)));
+		W[9] = (((uint32_t) *(blocks + 64 * i + 36)) << 24) | (((uint32_t) *(blocks + 64 * i + 37)) << 16) | (((uint32_t) *(blocks + 64 * i + 38)) << 8) | (((uint32_t) *(blocks + 64 * i + 39)));
+		W[10] = (((uint32_t) *(blocks + 64 * i + 40)) << 24) | (((uint32_t) *(blocks + 64 * i + 41)) << 16) | (((uint32_t) *(blocks + 64 * i + 42)) << 8) | (((uint32_t) *(blocks + 64 * i + 43)));
+		W[11] = (((uint32_t) *(blocks + 64 * i + 44)) << 24) | (((uint32_t) *(blocks + 64 * i + 45)) << 16) | (((uint32_t) *(blocks + 64 * i + 46)) << 8) | (((uint32_t) *(blocks + 64 * i + 47)));
+		W[12] = (((uint32_t) *(blocks + 64 * i + 48)) << 24) | (((uint32_t) *(blocks + 64 * i + 49)) << 16) | (((uint32_t) *(blocks + 64 * i + 50)) << 8) | (((uint32_t) *(blocks + 64 * i + 51)));
+		W[13] = (((uint32_t) *(blocks + 64 * i + 52)) << 24) | (((uint32_t) *(blocks + 64 * i + 53)) << 16) | (((uint32_t) *(blocks + 64 * i + 54)) << 8) | (((uint32_t) *(blocks + 64 * i + 55)));
+		W[14] = (((uint32_t) *(blocks + 64 * i + 56)) << 24) | (((uint32_t) *(blocks + 64 * i + 57)) << 16) | (((uint32_t) *(blocks + 64 * i + 58)) << 8) | (((uint32_t) *(blocks + 64 * i + 59)));
+	    W[15] = (((uint32_t) *(blocks + 64 * i + 60)) << 24) | (((uint32_t) *(blocks + 64 * i + 61)) << 16) | (((uint32_t) *(blocks + 64 * i + 62)) << 8) | (((uint32_t) *(blocks + 64 * i + 63)));
 
 		for(uint8_t j = 16; j <= 63; j++)
 		{
 			W[j] = s1(W[j-2]) + W[j-7] + s0(W[j-15]) + W[j-16];
 		}
 
-		uint32_t a = ctx->hashes[0];
-		uint32_t b = ctx->hashes[1];
-		uint32_t c = ctx->hashes[2];
-		uint32_t d = ctx->hashes[3];
-		uint32_t e = ctx->hashes[4];
-		uint32_t f = ctx->hashes[5];
-		uint32_t g = ctx->hashes[6];
-		uint32_t h = ctx->hashes[7];
+		uint32_t a = hashes[0];
+		uint32_t b = hashes[1];
+		uint32_t c = hashes[2];
+		uint32_t d = hashes[3];
+		uint32_t e = hashes[4];
+		uint32_t f = hashes[5];
+		uint32_t g = hashes[6];
+		uint32_t h = hashes[7];
 
 		for(uint8_t r = 0; r < 64; r++)
 		{
@@ -106,59 +185,138 @@ static void compute_hashes(Context* ctx)
 			b = a;
 			a = T1 + T2;
 		}
-		ctx->hashes[0] += a;
-		ctx->hashes[1] += b;
-		ctx->hashes[2] += c;
-		ctx->hashes[3] += d;
-		ctx->hashes[4] += e;
-		ctx->hashes[5] += f;
-		ctx->hashes[6] += g;
-		ctx->hashes[7] += h;
+		hashes[0] += a;
+		hashes[1] += b;
+		hashes[2] += c;
+		hashes[3] += d;
+		hashes[4] += e;
+		hashes[5] += f;
+		hashes[6] += g;
+		hashes[7] += h;
 
 	}
 
 }
 
-inline static void destroy_ctx(Context* ctx)
+void sha256_update(Context* ctx, const void* data, size_t length)
 {
-	free(ctx->padded);
+	const uint8_t* message = (const uint8_t *) data;
+	STATS_START();
+
+	//Nothing to buffer; data may be NULL here
+	if(length == 0)
+	{
+		STATS_STOP(SHA256_ENTRY_UPDATE, 0);
+		return;
+	}
+
+	ctx->length_in_bits += (uint64_t) length * 8;
+
+	if(ctx->block_length > 0)
+	{
+		size_t missing = 64 - ctx->block_length;
+
+		if(length < missing)
+		{
+			memcpy(ctx->block + ctx->block_length, message, length);
+			ctx->block_length += length;
+			STATS_STOP(SHA256_ENTRY_UPDATE, message - (const uint8_t *) data + length);
+			return;
+		}
+
+		memcpy(ctx->block + ctx->block_length, message, missing);
+		compute_hashes(ctx->hashes, ctx->block, 1);
+		ctx->block_length = 0;
+		message += missing;
+		length -= missing;
+	}
+
+	if(length >= 64)
+	{
+		compute_hashes(ctx->hashes, message, length / 64);
+		message += length - length % 64;
+		length %= 64;
+	}
+
+	memcpy(ctx->block, message, length);
+	ctx->block_length = length;
+	STATS_STOP(SHA256_ENTRY_UPDATE, message - (const uint8_t *) data + length);
 }
 
-void sha256_hash(const char* message, char* buffer)
+void sha256_final(Context* ctx, uint8_t digest[32])
+{
+	STATS_START();
+	pad_ctx(ctx);
+
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		*(digest + 4 * i) = (uint8_t) (ctx->hashes[i] >> 24);
+		*(digest + 4 * i + 1) = (uint8_t) (ctx->hashes[i] >> 16);
+		*(digest + 4 * i + 2) = (uint8_t) (ctx->hashes[i] >> 8);
+		*(digest + 4 * i + 3) = (uint8_t) (ctx->hashes[i]);
+	}
+	STATS_STOP(SHA256_ENTRY_FINAL, 0);
+}
+
+void sha256_clone(Context* copy, const Context* ctx)
 {
+	memcpy(copy, ctx, sizeof(Context));
+}
 
+void sha256_final_with(const Context* prefix, const void* suffix, size_t length, uint8_t digest[32])
+{
 	Context ctx;
-	init_ctx(&ctx, message);
-	pad_ctx(&ctx);
-	compute_hashes(&ctx);
 
-	char* digits = "0123456789abcdef";
+	memcpy(&ctx, prefix, sizeof(Context));
+	sha256_update(&ctx, suffix, length);
+	sha256_final(&ctx, digest);
+}
 
-	char* hash = (char *) malloc(sizeof(char) * 64);
+void sha256_digest(const void* data, size_t length, uint8_t digest[32])
+{
+	Context ctx;
+	STATS_START();
+	sha256_init(&ctx);
 
-	for(uint8_t i = 0; i < 8; i++)
+	ctx.length_in_bits = (uint64_t) length * 8;
+	ctx.block_length = length % 64;
+
+	if(length >= 64)
+	{
+		compute_hashes(ctx.hashes, (const uint8_t *) data, length / 64);
+	}
+
+	if(ctx.block_length > 0)
+	{
+		memcpy(ctx.block, (const uint8_t *) data + length - ctx.block_length, ctx.block_length);
+	}
+
+	sha256_final(&ctx, digest);
+	STATS_STOP(SHA256_ENTRY_DIGEST, length);
+}
+
+void sha256_to_hex(const uint8_t digest[32], char hex[65])
+{
+	const char* digits = "0123456789abcdef";
+	STATS_START();
+
+	for(uint8_t i = 0; i < 32; i++)
 	{
-		uint8_t h1 = (uint8_t) ((ctx.hashes[i] & (15 << 28)) >> 28);
-		uint8_t h2 = (uint8_t) ((ctx.hashes[i] & (15 << 24)) >> 24);
-		uint8_t h3 = (uint8_t) ((ctx.hashes[i] & (15 << 20)) >> 20);
-		uint8_t h4 = (uint8_t) ((ctx.hashes[i] & (15 << 16)) >> 16);
-		uint8_t h5 = (uint8_t) ((ctx.hashes[i] & (15 << 12)) >> 12);
-		uint8_t h6 = (uint8_t) ((ctx.hashes[i] & (15 << 8)) >> 8);
-		uint8_t h7 = (uint8_t) ((ctx.hashes[i] & (15 << 4)) >> 4);
-		uint8_t h8 = (uint8_t) ((ctx.hashes[i] & (15)));
-
-		*(hash + 8 * i) = digits[h1];
-		*(hash + 8 * i + 1) = digits[h2];
-		*(hash + 8 * i + 2) = digits[h3];
-		*(hash + 8 * i + 3) = digits[h4];
-		*(hash + 8 * i + 4) = digits[h5];
-		*(hash + 8 * i + 5) = digits[h6];
-		*(hash + 8 * i + 6) = digits[h7];
-		*(hash + 8 * i + 7) = digits[h8];
+		*(hex + 2 * i) = digits[digest[i] >> 4];
+		*(hex + 2 * i + 1) = digits[digest[i] & 15];
 	}
 
-	strcpy(buffer, hash);
-	free(hash);
-	destroy_ctx(&ctx);
+	*(hex + 64) = '\0';
+	STATS_STOP(SHA256_ENTRY_TO_HEX, 0);
+}
 
-}
\ No newline at end of file
+void sha256_hash(const char* message, char* buffer)
+{
+	uint8_t digest[32];
+	size_t length = strlen(message);
+	STATS_START();
+
+	sha256_digest(message, length, digest);
+	sha256_to_hex(digest, buffer);
+	STATS_STOP(SHA256_ENTRY_HASH, length);
+}
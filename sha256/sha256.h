@@ -33,23 +33,211 @@ static const uint32_t K[64] = {
 	0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
 };
 
+typedef enum SHA256Backend{
+	SHA256_BACKEND_AUTO,
+	SHA256_BACKEND_SCALAR,
+	SHA256_BACKEND_SHANI
+} SHA256Backend;
+
+typedef enum SHA256ManyBackend{
+	SHA256_MANY_AUTO,
+	SHA256_MANY_SERIAL,
+	SHA256_MANY_AVX2,
+	SHA256_MANY_AVX512
+} SHA256ManyBackend;
+
+//Tree hashing mode, version 1:
+//  leaf i = SHA256(header(0, version, i, length of chunk i) || chunk i)
+//  root   = SHA256(header(1, version, chunk_size, total length) || leaf 0 || leaf 1 || ...)
+//header is one 64-byte block: tag, version, then two big-endian 64-bit fields, zero filled.
+//The root depends only on the data and chunk_size, never on the number of threads.
+#define SHA256_TREE_VERSION 1
+
+typedef struct SHA256TreeParams{
+	size_t chunk_size;
+	unsigned threads;
+} SHA256TreeParams;
+
+//Merkle tree: leaf = SHA256(0x00 || data), node = SHA256(0x01 || left || right), and the last node of
+//an odd-sized level is promoted unchanged, which gives the same root as RFC 6962. The capacity is a power
+//of two and level l starts at node 2 * capacity - 2 * (capacity >> l). A zeroed struct is an empty tree.
+typedef struct SHA256Merkle{
+	uint8_t* nodes;
+	size_t number_of_leaves;
+	size_t capacity;
+} SHA256Merkle;
+
+//Chaining states after the ipad and opad blocks; set up once per key with sha256_hmac_key
+typedef struct SHA256HMACKey{
+	uint32_t inner[8];
+	uint32_t outer[8];
+} SHA256HMACKey;
+
+//Instrumentation, compiled in with -DSHA256_STATS; without it nothing is counted and the snapshot fails.
+//Entry latencies are inclusive, so sha256_hash also shows up under DIGEST, FINAL and TO_HEX.
+typedef enum SHA256StatsEntry{
+	SHA256_ENTRY_UPDATE,
+	SHA256_ENTRY_FINAL,
+	SHA256_ENTRY_DIGEST,
+	SHA256_ENTRY_TO_HEX,
+	SHA256_ENTRY_HASH,
+	SHA256_ENTRY_HASH_MANY,
+	SHA256_ENTRY_COMPRESS_MANY,
+	SHA256_ENTRY_HMAC,
+	SHA256_ENTRY_PBKDF2,
+	SHA256_ENTRY_TREE_HASH,
+	SHA256_ENTRY_DOUBLE,
+	SHA256_ENTRY_MERKLE,
+	SHA256_ENTRIES
+} SHA256StatsEntry;
+
+typedef enum SHA256StatsKernel{
+	SHA256_KERNEL_SCALAR,
+	SHA256_KERNEL_SHANI,
+	SHA256_KERNEL_AVX2_LANES,
+	SHA256_KERNEL_AVX512_LANES,
+	SHA256_KERNELS
+} SHA256StatsKernel;
+
+//latency[i] counts calls that took [2^i, 2^(i+1)) nanoseconds; the last bucket is open ended
+#define SHA256_STATS_BUCKETS 32
+
+typedef struct SHA256EntryStats{
+	uint64_t calls;
+	uint64_t bytes;
+	uint64_t latency[SHA256_STATS_BUCKETS];
+} SHA256EntryStats;
+
+//blocks counts compressed blocks per kernel; lane kernels count only lanes that carried a message.
+//bytes is the message bytes hashed, or the key bytes derived for PBKDF2; a call that fails still counts, with no bytes.
+typedef struct SHA256Stats{
+	SHA256Backend backend;
+	SHA256ManyBackend many_backend;
+	uint64_t blocks[SHA256_KERNELS];
+	SHA256EntryStats entries[SHA256_ENTRIES];
+} SHA256Stats;
+
 typedef struct SHA256Context{
-	const char* message;
     uint64_t length_in_bits;
-	uint16_t k;
-	uint64_t padded_length_in_bits;
-	uint8_t* padded;
+	uint8_t block[64];
+	uint8_t block_length;
 	uint32_t hashes[8];
 } Context;
 
-static void init_ctx(Context* ctx, const char* message);
+void sha256_init(Context* ctx);
+
+void sha256_update(Context* ctx, const void* data, size_t length);
 
-static void pad_ctx(Context* ctx);
+void sha256_final(Context* ctx, uint8_t digest[32]);
 
-static void compute_hashes(Context* ctx);
+//A context is a self-contained snapshot of the chaining state, the buffered partial block and the length,
+//so hashing a shared prefix once and cloning it lets many messages resume from there
+void sha256_clone(Context* copy, const Context* ctx);
 
-inline static void destroy_ctx(Context* ctx);
+//Hashes prefix || suffix without touching prefix
+void sha256_final_with(const Context* prefix, const void* suffix, size_t length, uint8_t digest[32]);
 
+//A checkpoint is a context as a fixed-size, big-endian record that can be stored and imported later, on any
+//machine, to resume hashing where it stopped; export before sha256_final, or take the digest with sha256_final_with
+#define SHA256_CHECKPOINT_SIZE 120
+#define SHA256_CHECKPOINT_VERSION 1
+
+void sha256_export(const Context* ctx, uint8_t checkpoint[SHA256_CHECKPOINT_SIZE]);
+
+//Returns -1 and leaves ctx untouched if the checkpoint is damaged, of another version or of another algorithm
+int sha256_import(Context* ctx, const uint8_t checkpoint[SHA256_CHECKPOINT_SIZE]);
+
+//One-shot hash of length bytes; does not allocate
+void sha256_digest(const void* data, size_t length, uint8_t digest[32]);
+
+void sha256_to_hex(const uint8_t digest[32], char hex[65]);
+
+//buffer receives the NUL-terminated hex digest and must hold 65 bytes
 void sha256_hash(const char* message, char* buffer);
 
+void sha256_hmac_key(SHA256HMACKey* key, const void* secret, size_t length);
+
+void sha256_hmac(const SHA256HMACKey* key, const void* data, size_t length, uint8_t mac[32]);
+
+//Streaming HMAC: sha256_hmac_init, any number of sha256_update calls, then sha256_hmac_final
+void sha256_hmac_init(Context* ctx, const SHA256HMACKey* key);
+
+void sha256_hmac_final(Context* ctx, const SHA256HMACKey* key, uint8_t mac[32]);
+
+//MACs count messages under one key; macs receives 32 * count bytes
+void sha256_hmac_many(const SHA256HMACKey* key, const uint8_t* const* messages, const size_t* lengths, size_t count, uint8_t* macs);
+
+//Derives key_length bytes; returns -1, leaving key untouched, when iterations is 0
+int sha256_pbkdf2(const void* password, size_t password_length, const void* salt, size_t salt_length, uint32_t iterations, uint8_t* key, size_t key_length);
+
+//Derives count keys of key_length bytes each, one per password, with the same salt and iteration count; returns -1 when iterations is 0
+int sha256_pbkdf2_many(const uint8_t* const* passwords, const size_t* password_lengths, size_t count, const void* salt, size_t salt_length, uint32_t iterations, uint8_t* keys, size_t key_length);
+
+//Sums the counters of every thread that has hashed so far; returns -1 when built without SHA256_STATS
+int sha256_stats_snapshot(SHA256Stats* stats);
+
+//sha256d: SHA256(SHA256(input)) for inputs of exactly 64 or 32 bytes, returned as raw bytes
+void sha256d_64(const uint8_t input[64], uint8_t digest[32]);
+
+void sha256d_32(const uint8_t input[32], uint8_t digest[32]);
+
+//count inputs laid out back to back, 64 (or 32) bytes each, hashed through the multi-buffer lanes
+void sha256d_64_many(const uint8_t* inputs, size_t count, uint8_t* digests);
+
+void sha256d_32_many(const uint8_t* inputs, size_t count, uint8_t* digests);
+
+//Hashes every leaf, then every level as one batch spread over threads (0 means all online cores); returns -1 if out of memory.
+//tree must be zeroed or hold an earlier tree, whose nodes are freed first.
+int sha256_merkle_build(SHA256Merkle* tree, const uint8_t* const* leaves, const size_t* lengths, size_t count, unsigned threads);
+
+void sha256_merkle_free(SHA256Merkle* tree);
+
+//The root of an empty tree is SHA256 of the empty string
+void sha256_merkle_root(const SHA256Merkle* tree, uint8_t root[32]);
+
+//Both rehash only the path from the leaf to the root; update returns -1 for an index past the end,
+//append returns -1 if growing the array runs out of memory
+int sha256_merkle_update(SHA256Merkle* tree, size_t index, const void* leaf, size_t length);
+
+int sha256_merkle_append(SHA256Merkle* tree, const void* leaf, size_t length);
+
+//Writes the sibling hashes from the leaf upwards and returns how many; proof must hold 32 * 64 bytes
+size_t sha256_merkle_proof(const SHA256Merkle* tree, size_t index, uint8_t* proof);
+
+//Returns 1 if leaf is at index in a tree of number_of_leaves leaves with this root, 0 otherwise
+int sha256_merkle_verify(const uint8_t root[32], size_t index, size_t number_of_leaves, const void* leaf, size_t length, const uint8_t* proof, size_t siblings);
+
+//Compression backends are chosen once at startup; forcing one returns -1 if the CPU lacks it.
+//Do not switch backends while other threads are hashing.
+int sha256_set_backend(SHA256Backend backend);
+
+SHA256Backend sha256_get_backend(void);
+
+//Known-answer tests (FIPS 180 examples, padding boundaries, Monte Carlo, checkpoint round trips) on the backends selected now; returns the number of failures
+int sha256_known_answers(void);
+
+//Runs the known-answer tests on every backend this CPU supports, then restores the selection; returns the number of failures
+int sha256_selftest(void);
+
+//chunk_size 0 means 1 MiB, threads 0 means all online cores; returns -1 if out of memory
+int sha256_tree_hash(const void* data, size_t length, const SHA256TreeParams* params, uint8_t digest[32]);
+
+void sha256_compress(uint32_t hashes[8], const uint8_t* blocks, uint64_t number_of_blocks);
+
+//Hashes count independent messages 8 (AVX2) or 16 (AVX-512) at a time; digests receives 32 * count bytes
+void sha256_hash_many(const uint8_t* const* messages, const size_t* lengths, size_t count, uint8_t* digests);
+
+//As sha256_hash_many, with every message continuing from the chaining state hashes reached after prefix_length bytes (a multiple of 64)
+void sha256_hash_many_from(const uint32_t hashes[8], uint64_t prefix_length, const uint8_t* const* messages, const size_t* lengths, size_t count, uint8_t* digests);
+
+//Hashes prefix || messages[i] for every message through the lanes, leaving prefix untouched
+void sha256_hash_many_after(const Context* prefix, const uint8_t* const* messages, const size_t* lengths, size_t count, uint8_t* digests);
+
+//Compresses one block into each of count independent chaining states; hashes holds 8 * count words
+void sha256_compress_many(uint32_t* hashes, const uint8_t* const* blocks, size_t count);
+
+int sha256_set_many_backend(SHA256ManyBackend backend);
+
+SHA256ManyBackend sha256_get_many_backend(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,102 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha256_hmac.c - HMAC-SHA256 with the ipad/opad blocks compressed once per key
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+//For explicit_bzero
+#define _DEFAULT_SOURCE
+#include "sha256_stats.h"
+
+void sha256_hmac_key(SHA256HMACKey* key, const void* secret, size_t length)
+{
+	uint8_t block[64];
+	Context ctx;
+
+	memset(block, 0, 64);
+	if(length > 64)
+	{
+		sha256_digest(secret, length, block);
+	}
+	else if(length > 0)
+	{
+		memcpy(block, secret, length);
+	}
+
+	for(uint8_t i = 0; i < 64; i++)
+	{
+		*(block + i) ^= 0x36;
+	}
+	sha256_init(&ctx);
+	sha256_compress(ctx.hashes, block, 1);
+	memcpy(key->inner, ctx.hashes, sizeof(key->inner));
+
+	for(uint8_t i = 0; i < 64; i++)
+	{
+		*(block + i) ^= 0x36 ^ 0x5c;
+	}
+	sha256_init(&ctx);
+	sha256_compress(ctx.hashes, block, 1);
+	memcpy(key->outer, ctx.hashes, sizeof(key->outer));
+
+	//The padded key and the midstate are key material, and a plain memset of dead locals may be dropped
+	explicit_bzero(block, 64);
+	explicit_bzero(&ctx, sizeof(ctx));
+}
+
+void sha256_hmac_init(Context* ctx, const SHA256HMACKey* key)
+{
+	memcpy(ctx->hashes, key->inner, sizeof(ctx->hashes));
+	ctx->length_in_bits = 512;
+	ctx->block_length = 0;
+}
+
+void sha256_hmac_final(Context* ctx, const SHA256HMACKey* key, uint8_t mac[32])
+{
+	uint8_t inner[32];
+
+	sha256_final(ctx, inner);
+
+	memcpy(ctx->hashes, key->outer, sizeof(ctx->hashes));
+	ctx->length_in_bits = 512;
+	ctx->block_length = 0;
+	sha256_update(ctx, inner, 32);
+	sha256_final(ctx, mac);
+}
+
+void sha256_hmac(const SHA256HMACKey* key, const void* data, size_t length, uint8_t mac[32])
+{
+	Context ctx;
+	STATS_START();
+
+	sha256_hmac_init(&ctx, key);
+	sha256_update(&ctx, data, length);
+	sha256_hmac_final(&ctx, key, mac);
+	STATS_STOP(SHA256_ENTRY_HMAC, length);
+}
+
+//Both passes run through the multi-buffer lanes, 64 messages at a time; the outer pass is one block per message.
+//The inner digests are staged apart from macs, since sha256_hash_many_from does not promise in-place hashing.
+void sha256_hmac_many(const SHA256HMACKey* key, const uint8_t* const* messages, const size_t* lengths, size_t count, uint8_t* macs)
+{
+	uint8_t inner_digests[32 * 64];
+	const uint8_t* inner[64];
+	size_t inner_lengths[64];
+	STATS_START();
+
+	for(size_t done = 0; done < count; done += 64)
+	{
+		size_t batch = count - done < 64 ? count - done : 64;
+
+		sha256_hash_many_from(key->inner, 64, messages + done, lengths + done, batch, inner_digests);
+		for(size_t i = 0; i < batch; i++)
+		{
+			inner[i] = inner_digests + 32 * i;
+			inner_lengths[i] = 32;
+		}
+
+		sha256_hash_many_from(key->outer, 64, inner, inner_lengths, batch, macs + 32 * done);
+	}
+
+	STATS_STOP(SHA256_ENTRY_HMAC, stats_total(lengths, count));
+}
@@ -0,0 +1,346 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha256_merkle.c - Merkle tree over SHA256 kept in one level-ordered array, with O(log n) updates and proofs
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include "sha256_stats.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+//Items a worker claims at once, and the smallest level worth spreading over threads
+#define CLAIM 1024
+#define PARALLEL_THRESHOLD 8192
+//Pairs handed to the lanes per call
+#define WINDOW 64
+
+typedef struct SHA256MerkleJob{
+	Context prefix;
+	const uint8_t* const* messages;
+	const size_t* lengths;
+	const uint8_t* children;
+	uint8_t* output;
+	size_t count;
+	atomic_size_t next;
+} MerkleJob;
+
+//With capacity a power of two, level l starts at node 2 * capacity - 2 * (capacity >> l)
+static uint8_t* level_nodes(const SHA256Merkle* tree, uint8_t level)
+{
+	return tree->nodes + 32 * (2 * tree->capacity - 2 * (tree->capacity >> level));
+}
+
+static size_t level_width(size_t number_of_leaves, uint8_t level)
+{
+	return ((number_of_leaves - 1) >> level) + 1;
+}
+
+static void tagged_prefix(Context* ctx, uint8_t tag)
+{
+	sha256_init(ctx);
+	sha256_update(ctx, &tag, 1);
+}
+
+//Leaves come from the caller's pointers; a node level reads its children as adjacent 64-byte pairs
+static void* hash_items(void* argument)
+{
+	MerkleJob* job = (MerkleJob *) argument;
+	const uint8_t* pairs[WINDOW];
+	size_t lengths[WINDOW];
+	size_t start;
+
+	for(uint8_t i = 0; i < WINDOW; i++)
+	{
+		lengths[i] = 64;
+	}
+
+	while((start = atomic_fetch_add(&job->next, CLAIM)) < job->count)
+	{
+		size_t end = job->count - start < CLAIM ? job->count : start + CLAIM;
+
+		if(job->messages != NULL)
+		{
+			sha256_hash_many_after(&job->prefix, job->messages + start, job->lengths + start, end - start, job->output + 32 * start);
+			continue;
+		}
+
+		for(size_t done = start; done < end; done += WINDOW)
+		{
+			size_t window = end - done < WINDOW ? end - done : WINDOW;
+
+			for(size_t i = 0; i < window; i++)
+			{
+				pairs[i] = job->children + 64 * (done + i);
+			}
+			sha256_hash_many_after(&job->prefix, pairs, lengths, window, job->output + 32 * done);
+		}
+	}
+
+	return NULL;
+}
+
+static void run_job(MerkleJob* job, unsigned threads)
+{
+	size_t wanted = job->count < PARALLEL_THRESHOLD ? 1 : (job->count - 1) / CLAIM + 1;
+	pthread_t workers[64];
+	size_t started = 0;
+
+	atomic_init(&job->next, 0);
+	if(wanted > threads)
+	{
+		wanted = threads;
+	}
+	if(wanted > 64)
+	{
+		wanted = 64;
+	}
+
+	while(started + 1 < wanted && pthread_create(&workers[started], NULL, hash_items, job) == 0)
+	{
+		started++;
+	}
+
+	hash_items(job);
+
+	for(size_t i = 0; i < started; i++)
+	{
+		pthread_join(workers[i], NULL);
+	}
+}
+
+//Rehashes the parents of index up to the root; an unpaired last node is promoted unchanged
+static void update_path(SHA256Merkle* tree, size_t index)
+{
+	Context prefix;
+
+	tagged_prefix(&prefix, 1);
+
+	for(uint8_t level = 0; level_width(tree->number_of_leaves, level) > 1; level++)
+	{
+		const uint8_t* children = level_nodes(tree, level);
+		uint8_t* parent = level_nodes(tree, level + 1) + 32 * (index / 2);
+		size_t left = index & ~(size_t) 1;
+
+		if(left + 1 < level_width(tree->number_of_leaves, level))
+		{
+			sha256_final_with(&prefix, children + 32 * left, 64, parent);
+		}
+		else
+		{
+			memcpy(parent, children + 32 * left, 32);
+		}
+
+		index /= 2;
+	}
+}
+
+//Doubles the capacity; every level keeps its width, so only the offsets move
+static int grow(SHA256Merkle* tree, size_t capacity)
+{
+	uint8_t* nodes = (uint8_t *) malloc(32 * (2 * capacity - 1));
+	SHA256Merkle grown = { nodes, tree->number_of_leaves, capacity };
+
+	if(nodes == NULL)
+	{
+		return -1;
+	}
+
+	for(uint8_t level = 0; tree->number_of_leaves > 0 && (tree->capacity >> level) > 0; level++)
+	{
+		memcpy(level_nodes(&grown, level), level_nodes(tree, level), 32 * level_width(tree->number_of_leaves, level));
+	}
+
+	free(tree->nodes);
+	tree->nodes = nodes;
+	tree->capacity = capacity;
+	return 0;
+}
+
+int sha256_merkle_build(SHA256Merkle* tree, const uint8_t* const* leaves, const size_t* lengths, size_t count, unsigned threads)
+{
+	MerkleJob job;
+	STATS_START();
+
+	//Rebuilding replaces whatever the tree held
+	sha256_merkle_free(tree);
+
+	size_t capacity = 1;
+	while(capacity < count)
+	{
+		capacity *= 2;
+	}
+	if(grow(tree, capacity) != 0)
+	{
+		STATS_STOP(SHA256_ENTRY_MERKLE, 0);
+		return -1;
+	}
+	tree->number_of_leaves = count;
+
+	if(count == 0)
+	{
+		STATS_STOP(SHA256_ENTRY_MERKLE, 0);
+		return 0;
+	}
+
+	if(threads == 0)
+	{
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = online > 0 ? (unsigned) online : 1;
+	}
+
+	tagged_prefix(&job.prefix, 0);
+	job.messages = leaves;
+	job.lengths = lengths;
+	job.output = level_nodes(tree, 0);
+	job.count = count;
+	run_job(&job, threads);
+
+	//Each level is hashed as one batch of adjacent pairs before the next one starts
+	tagged_prefix(&job.prefix, 1);
+	job.messages = NULL;
+	for(uint8_t level = 0; level_width(count, level) > 1; level++)
+	{
+		size_t width = level_width(count, level);
+
+		job.children = level_nodes(tree, level);
+		job.output = level_nodes(tree, level + 1);
+		job.count = width / 2;
+		run_job(&job, threads);
+
+		if(width % 2 == 1)
+		{
+			memcpy(job.output + 32 * (width / 2), job.children + 32 * (width - 1), 32);
+		}
+	}
+
+	STATS_STOP(SHA256_ENTRY_MERKLE, stats_total(lengths, count));
+	return 0;
+}
+
+void sha256_merkle_free(SHA256Merkle* tree)
+{
+	free(tree->nodes);
+	tree->nodes = NULL;
+	tree->number_of_leaves = 0;
+	tree->capacity = 0;
+}
+
+void sha256_merkle_root(const SHA256Merkle* tree, uint8_t root[32])
+{
+	uint8_t level = 0;
+
+	if(tree->number_of_leaves == 0)
+	{
+		sha256_digest(NULL, 0, root);
+		return;
+	}
+
+	while(level_width(tree->number_of_leaves, level) > 1)
+	{
+		level++;
+	}
+	memcpy(root, level_nodes(tree, level), 32);
+}
+
+int sha256_merkle_update(SHA256Merkle* tree, size_t index, const void* leaf, size_t length)
+{
+	Context prefix;
+	STATS_START();
+
+	if(index >= tree->number_of_leaves)
+	{
+		STATS_STOP(SHA256_ENTRY_MERKLE, 0);
+		return -1;
+	}
+
+	tagged_prefix(&prefix, 0);
+	sha256_final_with(&prefix, leaf, length, level_nodes(tree, 0) + 32 * index);
+	update_path(tree, index);
+
+	STATS_STOP(SHA256_ENTRY_MERKLE, length);
+	return 0;
+}
+
+int sha256_merkle_append(SHA256Merkle* tree, const void* leaf, size_t length)
+{
+	Context prefix;
+	STATS_START();
+
+	if(tree->number_of_leaves == tree->capacity && grow(tree, tree->capacity > 0 ? 2 * tree->capacity : 1) != 0)
+	{
+		STATS_STOP(SHA256_ENTRY_MERKLE, 0);
+		return -1;
+	}
+
+	tagged_prefix(&prefix, 0);
+	sha256_final_with(&prefix, leaf, length, level_nodes(tree, 0) + 32 * tree->number_of_leaves);
+	tree->number_of_leaves++;
+	update_path(tree, tree->number_of_leaves - 1);
+
+	STATS_STOP(SHA256_ENTRY_MERKLE, length);
+	return 0;
+}
+
+size_t sha256_merkle_proof(const SHA256Merkle* tree, size_t index, uint8_t* proof)
+{
+	size_t siblings = 0;
+
+	if(index >= tree->number_of_leaves)
+	{
+		return 0;
+	}
+
+	for(uint8_t level = 0; level_width(tree->number_of_leaves, level) > 1; level++)
+	{
+		size_t sibling = index ^ 1;
+
+		if(sibling < level_width(tree->number_of_leaves, level))
+		{
+			memcpy(proof + 32 * siblings, level_nodes(tree, level) + 32 * sibling, 32);
+			siblings++;
+		}
+
+		index /= 2;
+	}
+
+	return siblings;
+}
+
+int sha256_merkle_verify(const uint8_t root[32], size_t index, size_t number_of_leaves, const void* leaf, size_t length, const uint8_t* proof, size_t siblings)
+{
+	uint8_t node[32];
+	uint8_t pair[64];
+	size_t used = 0;
+	Context prefix;
+
+	if(index >= number_of_leaves)
+	{
+		return 0;
+	}
+
+	tagged_prefix(&prefix, 0);
+	sha256_final_with(&prefix, leaf, length, node);
+	tagged_prefix(&prefix, 1);
+
+	//Walks the same shape as the tree: a node without a sibling at its level is carried up unchanged
+	for(size_t width = number_of_leaves; width > 1; width = (width + 1) / 2)
+	{
+		if((index & 1) == 1 || index + 1 < width)
+		{
+			if(used == siblings)
+			{
+				return 0;
+			}
+
+			memcpy(pair + ((index & 1) == 1 ? 32 : 0), node, 32);
+			memcpy(pair + ((index & 1) == 1 ? 0 : 32), proof + 32 * used, 32);
+			sha256_final_with(&prefix, pair, 64, node);
+			used++;
+		}
+
+		index /= 2;
+	}
+
+	return used == siblings && memcmp(node, root, 32) == 0;
+}
@@ -0,0 +1,498 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha256_multi.c - Multi-buffer SHA256 hashing many independent messages in SIMD lanes
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include "sha256_stats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define MAX_LANES 16
+#define LANE_KERNEL (selected_backend == SHA256_MANY_AVX512 ? SHA256_KERNEL_AVX512_LANES : SHA256_KERNEL_AVX2_LANES)
+
+typedef struct SHA256Lane{
+	const uint8_t* message;
+	uint64_t message_blocks;
+	uint8_t first[64];
+	int staged_first;
+	uint8_t tail[128];
+	uint8_t tail_blocks;
+	uint8_t tail_done;
+	size_t index;
+	int active;
+} Lane;
+
+static const uint8_t idle_block[64];
+
+static void compress_lanes_serial(uint32_t state[8][MAX_LANES], const uint8_t* blocks[MAX_LANES]);
+
+#if defined(__x86_64__) || defined(__i386__)
+static void compress_lanes_avx2(uint32_t state[8][MAX_LANES], const uint8_t* blocks[MAX_LANES]);
+
+static void compress_lanes_avx512(uint32_t state[8][MAX_LANES], const uint8_t* blocks[MAX_LANES]);
+#endif
+
+static void (*compress_lanes)(uint32_t state[8][MAX_LANES], const uint8_t* blocks[MAX_LANES]) = compress_lanes_serial;
+static uint8_t number_of_lanes = 1;
+static SHA256ManyBackend selected_backend = SHA256_MANY_SERIAL;
+
+static int backend_supported(SHA256ManyBackend backend)
+{
+	switch(backend)
+	{
+		case SHA256_MANY_SERIAL:
+			return 1;
+#if defined(__x86_64__) || defined(__i386__)
+		case SHA256_MANY_AVX2:
+			return __builtin_cpu_supports("avx2");
+		case SHA256_MANY_AVX512:
+			return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2");
+#endif
+		default:
+			return 0;
+	}
+}
+
+int sha256_set_many_backend(SHA256ManyBackend backend)
+{
+	if(backend == SHA256_MANY_AUTO)
+	{
+		//Eight AVX2 lanes do not beat one SHA-NI stream, sixteen AVX-512 lanes do
+		backend = backend_supported(SHA256_MANY_AVX512) ? SHA256_MANY_AVX512 : SHA256_MANY_SERIAL;
+#if defined(__x86_64__) || defined(__i386__)
+		if(backend == SHA256_MANY_SERIAL && backend_supported(SHA256_MANY_AVX2) && !__builtin_cpu_supports("sha"))
+		{
+			backend = SHA256_MANY_AVX2;
+		}
+#endif
+	}
+
+	if(!backend_supported(backend))
+	{
+		return -1;
+	}
+
+	switch(backend)
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		case SHA256_MANY_AVX2:
+			compress_lanes = compress_lanes_avx2;
+			number_of_lanes = 8;
+			break;
+		case SHA256_MANY_AVX512:
+			compress_lanes = compress_lanes_avx512;
+			number_of_lanes = 16;
+			break;
+#endif
+		default:
+			compress_lanes = compress_lanes_serial;
+			number_of_lanes = 1;
+			break;
+	}
+
+	selected_backend = backend;
+	return 0;
+}
+
+SHA256ManyBackend sha256_get_many_backend(void)
+{
+	return selected_backend;
+}
+
+__attribute__((constructor)) static void select_many_backend(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+#endif
+	sha256_set_many_backend(SHA256_MANY_AUTO);
+}
+
+//Full blocks are read in place; the last partial block and the padding go to the lane's tail.
+//Bytes the prefix left buffered are joined with the start of the message in the lane's first block.
+static void start_lane(Lane* lane, uint32_t state[8][MAX_LANES], uint8_t l, const Context* prefix, const uint8_t* message, size_t length, size_t index)
+{
+	uint8_t head = prefix->block_length;
+	uint64_t total = head + length;
+	uint64_t length_in_bits = prefix->length_in_bits + (uint64_t) length * 8;
+	size_t rest = total % 64;
+
+	lane->message = message;
+	lane->message_blocks = total / 64;
+	lane->staged_first = head > 0 && total >= 64;
+	lane->tail_blocks = rest < 56 ? 1 : 2;
+	lane->tail_done = 0;
+	lane->index = index;
+	lane->active = 1;
+
+	if(lane->staged_first)
+	{
+		memcpy(lane->first, prefix->block, head);
+		memcpy(lane->first + head, message, 64 - head);
+		lane->message += 64 - head;
+	}
+
+	memset(lane->tail, 0, sizeof(lane->tail));
+	if(total < 64)
+	{
+		memcpy(lane->tail, prefix->block, head);
+		if(length > 0)
+		{
+			memcpy(lane->tail + head, message, length);
+		}
+	}
+	else if(rest > 0)
+	{
+		memcpy(lane->tail, message + length - rest, rest);
+	}
+	*(lane->tail + rest) = 128;
+
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		*(lane->tail + 64 * lane->tail_blocks - 1 - i) = (uint8_t) (length_in_bits >> (8 * i));
+	}
+
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		state[i][l] = prefix->hashes[i];
+	}
+}
+
+static const uint8_t* next_block(Lane* lane)
+{
+	if(lane->staged_first)
+	{
+		lane->staged_first = 0;
+		lane->message_blocks--;
+		return lane->first;
+	}
+
+	if(lane->message_blocks > 0)
+	{
+		const uint8_t* block = lane->message;
+		lane->message += 64;
+		lane->message_blocks--;
+		return block;
+	}
+
+	return lane->tail + 64 * lane->tail_done++;
+}
+
+void sha256_hash_many(const uint8_t* const* messages, const size_t* lengths, size_t count, uint8_t* digests)
+{
+	Context ctx;
+	sha256_init(&ctx);
+	sha256_hash_many_after(&ctx, messages, lengths, count, digests);
+}
+
+void sha256_hash_many_from(const uint32_t hashes[8], uint64_t prefix_length, const uint8_t* const* messages, const size_t* lengths, size_t count, uint8_t* digests)
+{
+	Context ctx;
+	memcpy(ctx.hashes, hashes, sizeof(ctx.hashes));
+	ctx.length_in_bits = prefix_length * 8;
+	ctx.block_length = 0;
+	sha256_hash_many_after(&ctx, messages, lengths, count, digests);
+}
+
+void sha256_hash_many_after(const Context* prefix, const uint8_t* const* messages, const size_t* lengths, size_t count, uint8_t* digests)
+{
+	STATS_START();
+
+	if(number_of_lanes == 1)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			sha256_final_with(prefix, messages[i], lengths[i], digests + 32 * i);
+		}
+		STATS_STOP(SHA256_ENTRY_HASH_MANY, stats_total(lengths, count));
+		return;
+	}
+
+	Lane lanes[MAX_LANES];
+	__attribute__((aligned(64))) uint32_t state[8][MAX_LANES];
+	const uint8_t* blocks[MAX_LANES];
+	size_t next = 0;
+	uint8_t active = 0;
+
+	for(uint8_t l = 0; l < number_of_lanes; l++)
+	{
+		lanes[l].active = 0;
+		if(next < count)
+		{
+			start_lane(&lanes[l], state, l, prefix, messages[next], lengths[next], next);
+			next++;
+			active++;
+		}
+	}
+
+	//Lanes that finish are refilled with the next message; once the queue is empty they idle on a zero block
+	while(active > 0)
+	{
+		for(uint8_t l = 0; l < number_of_lanes; l++)
+		{
+			blocks[l] = lanes[l].active ? next_block(&lanes[l]) : idle_block;
+		}
+
+		compress_lanes(state, blocks);
+		STATS_BLOCKS(LANE_KERNEL, active);
+
+		for(uint8_t l = 0; l < number_of_lanes; l++)
+		{
+			if(!lanes[l].active || lanes[l].message_blocks > 0 || lanes[l].tail_done < lanes[l].tail_blocks)
+			{
+				continue;
+			}
+
+			uint8_t* digest = digests + 32 * lanes[l].index;
+
+			for(uint8_t i = 0; i < 8; i++)
+			{
+				*(digest + 4 * i) = (uint8_t) (state[i][l] >> 24);
+				*(digest + 4 * i + 1) = (uint8_t) (state[i][l] >> 16);
+				*(digest + 4 * i + 2) = (uint8_t) (state[i][l] >> 8);
+				*(digest + 4 * i + 3) = (uint8_t) (state[i][l]);
+			}
+
+			lanes[l].active = 0;
+			active--;
+
+			if(next < count)
+			{
+				start_lane(&lanes[l], state, l, prefix, messages[next], lengths[next], next);
+				next++;
+				active++;
+			}
+		}
+	}
+
+	STATS_STOP(SHA256_ENTRY_HASH_MANY, stats_total(lengths, count));
+}
+
+//Partial groups go one by one when SHA-NI is active, since a single SHA-NI stream beats a mostly idle vector
+void sha256_compress_many(uint32_t* hashes, const uint8_t* const* blocks, size_t count)
+{
+	__attribute__((aligned(64))) uint32_t state[8][MAX_LANES];
+	const uint8_t* lane_blocks[MAX_LANES];
+	STATS_START();
+
+	memset(state, 0, sizeof(state));
+
+	for(size_t done = 0; done < count; done += number_of_lanes)
+	{
+		size_t group = count - done < number_of_lanes ? count - done : number_of_lanes;
+
+		if(group == 1 || (group < number_of_lanes && sha256_get_backend() == SHA256_BACKEND_SHANI))
+		{
+			for(size_t i = done; i < done + group; i++)
+			{
+				sha256_compress(hashes + 8 * i, blocks[i], 1);
+			}
+			continue;
+		}
+
+		for(uint8_t l = 0; l < number_of_lanes; l++)
+		{
+			lane_blocks[l] = l < group ? blocks[done + l] : idle_block;
+			for(uint8_t i = 0; i < 8 && l < group; i++)
+			{
+				state[i][l] = hashes[8 * (done + l) + i];
+			}
+		}
+
+		compress_lanes(state, lane_blocks);
+		STATS_BLOCKS(LANE_KERNEL, group);
+
+		for(uint8_t l = 0; l < group; l++)
+		{
+			for(uint8_t i = 0; i < 8; i++)
+			{
+				hashes[8 * (done + l) + i] = state[i][l];
+			}
+		}
+	}
+
+	STATS_STOP(SHA256_ENTRY_COMPRESS_MANY, 64 * (uint64_t) count);
+}
+
+static void compress_lanes_serial(uint32_t state[8][MAX_LANES], const uint8_t* blocks[MAX_LANES])
+{
+	uint32_t hashes[8];
+
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		hashes[i] = state[i][0];
+	}
+
+	sha256_compress(hashes, blocks[0], 1);
+
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		state[i][0] = hashes[i];
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#define RotR256(A, n) _mm256_or_si256(_mm256_srli_epi32(A, n), _mm256_slli_epi32(A, 32 - (n)))
+#define S0_256(X) _mm256_xor_si256(_mm256_xor_si256(RotR256(X, 2), RotR256(X, 13)), RotR256(X, 22))
+#define S1_256(X) _mm256_xor_si256(_mm256_xor_si256(RotR256(X, 6), RotR256(X, 11)), RotR256(X, 25))
+#define s0_256(X) _mm256_xor_si256(_mm256_xor_si256(RotR256(X, 7), RotR256(X, 18)), _mm256_srli_epi32(X, 3))
+#define s1_256(X) _mm256_xor_si256(_mm256_xor_si256(RotR256(X, 17), RotR256(X, 19)), _mm256_srli_epi32(X, 10))
+#define Ch256(X, Y, Z) _mm256_xor_si256(_mm256_and_si256(X, Y), _mm256_andnot_si256(X, Z))
+#define Maj256(X, Y, Z) _mm256_or_si256(_mm256_and_si256(X, Y), _mm256_and_si256(Z, _mm256_or_si256(X, Y)))
+
+//Loads 32 bytes from each of eight blocks and transposes them so that out[t] holds word t of every lane
+__attribute__((target("avx2")))
+static inline void load_transposed_8(const uint8_t* blocks[8], size_t offset, __m256i out[8])
+{
+	const __m256i byte_swap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3, 12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+	__m256i r[8];
+	__m256i t[8];
+
+	for(uint8_t l = 0; l < 8; l++)
+	{
+		r[l] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (blocks[l] + offset)), byte_swap);
+	}
+
+	for(uint8_t l = 0; l < 8; l += 2)
+	{
+		t[l] = _mm256_unpacklo_epi32(r[l], r[l + 1]);
+		t[l + 1] = _mm256_unpackhi_epi32(r[l], r[l + 1]);
+	}
+
+	r[0] = _mm256_unpacklo_epi64(t[0], t[2]);
+	r[1] = _mm256_unpackhi_epi64(t[0], t[2]);
+	r[2] = _mm256_unpacklo_epi64(t[1], t[3]);
+	r[3] = _mm256_unpackhi_epi64(t[1], t[3]);
+	r[4] = _mm256_unpacklo_epi64(t[4], t[6]);
+	r[5] = _mm256_unpackhi_epi64(t[4], t[6]);
+	r[6] = _mm256_unpacklo_epi64(t[5], t[7]);
+	r[7] = _mm256_unpackhi_epi64(t[5], t[7]);
+
+	for(uint8_t i = 0; i < 4; i++)
+	{
+		out[i] = _mm256_permute2x128_si256(r[i], r[i + 4], 0x20);
+		out[i + 4] = _mm256_permute2x128_si256(r[i], r[i + 4], 0x31);
+	}
+}
+
+__attribute__((target("avx2")))
+static void compress_lanes_avx2(uint32_t state[8][MAX_LANES], const uint8_t* blocks[MAX_LANES])
+{
+	__m256i W[16];
+
+	load_transposed_8(blocks, 0, W);
+	load_transposed_8(blocks, 32, W + 8);
+
+	__m256i a = _mm256_load_si256((const __m256i *) state[0]);
+	__m256i b = _mm256_load_si256((const __m256i *) state[1]);
+	__m256i c = _mm256_load_si256((const __m256i *) state[2]);
+	__m256i d = _mm256_load_si256((const __m256i *) state[3]);
+	__m256i e = _mm256_load_si256((const __m256i *) state[4]);
+	__m256i f = _mm256_load_si256((const __m256i *) state[5]);
+	__m256i g = _mm256_load_si256((const __m256i *) state[6]);
+	__m256i h = _mm256_load_si256((const __m256i *) state[7]);
+
+	for(uint8_t r = 0; r < 64; r++)
+	{
+		if(r >= 16)
+		{
+			W[r % 16] = _mm256_add_epi32(_mm256_add_epi32(s1_256(W[(r - 2) % 16]), W[(r - 7) % 16]), _mm256_add_epi32(s0_256(W[(r - 15) % 16]), W[r % 16]));
+		}
+
+		__m256i T1 = _mm256_add_epi32(_mm256_add_epi32(h, S1_256(e)), _mm256_add_epi32(Ch256(e, f, g), _mm256_add_epi32(_mm256_set1_epi32(K[r]), W[r % 16])));
+		__m256i T2 = _mm256_add_epi32(S0_256(a), Maj256(a, b, c));
+		h = g;
+		g = f;
+		f = e;
+		e = _mm256_add_epi32(d, T1);
+		d = c;
+		c = b;
+		b = a;
+		a = _mm256_add_epi32(T1, T2);
+	}
+
+	_mm256_store_si256((__m256i *) state[0], _mm256_add_epi32(a, _mm256_load_si256((const __m256i *) state[0])));
+	_mm256_store_si256((__m256i *) state[1], _mm256_add_epi32(b, _mm256_load_si256((const __m256i *) state[1])));
+	_mm256_store_si256((__m256i *) state[2], _mm256_add_epi32(c, _mm256_load_si256((const __m256i *) state[2])));
+	_mm256_store_si256((__m256i *) state[3], _mm256_add_epi32(d, _mm256_load_si256((const __m256i *) state[3])));
+	_mm256_store_si256((__m256i *) state[4], _mm256_add_epi32(e, _mm256_load_si256((const __m256i *) state[4])));
+	_mm256_store_si256((__m256i *) state[5], _mm256_add_epi32(f, _mm256_load_si256((const __m256i *) state[5])));
+	_mm256_store_si256((__m256i *) state[6], _mm256_add_epi32(g, _mm256_load_si256((const __m256i *) state[6])));
+	_mm256_store_si256((__m256i *) state[7], _mm256_add_epi32(h, _mm256_load_si256((const __m256i *) state[7])));
+}
+
+#define Xor3_512(X, Y, Z) _mm512_ternarylogic_epi32(X, Y, Z, 0x96)
+#define S0_512(X) Xor3_512(_mm512_ror_epi32(X, 2), _mm512_ror_epi32(X, 13), _mm512_ror_epi32(X, 22))
+#define S1_512(X) Xor3_512(_mm512_ror_epi32(X, 6), _mm512_ror_epi32(X, 11), _mm512_ror_epi32(X, 25))
+#define s0_512(X) Xor3_512(_mm512_ror_epi32(X, 7), _mm512_ror_epi32(X, 18), _mm512_srli_epi32(X, 3))
+#define s1_512(X) Xor3_512(_mm512_ror_epi32(X, 17), _mm512_ror_epi32(X, 19), _mm512_srli_epi32(X, 10))
+#define Ch512(X, Y, Z) _mm512_ternarylogic_epi32(X, Y, Z, 0xCA)
+#define Maj512(X, Y, Z) _mm512_ternarylogic_epi32(X, Y, Z, 0xE8)
+
+__attribute__((target("avx512f,avx2")))
+static void compress_lanes_avx512(uint32_t state[8][MAX_LANES], const uint8_t* blocks[MAX_LANES])
+{
+	__m512i W[16];
+	__m512i S[8];
+
+	for(uint8_t half = 0; half < 2; half++)
+	{
+		__m256i low[8];
+		__m256i high[8];
+
+		load_transposed_8(blocks, 32 * half, low);
+		load_transposed_8(blocks + 8, 32 * half, high);
+
+		for(uint8_t i = 0; i < 8; i++)
+		{
+			W[8 * half + i] = _mm512_inserti64x4(_mm512_castsi256_si512(low[i]), high[i], 1);
+		}
+	}
+
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		S[i] = _mm512_load_si512((const void *) state[i]);
+	}
+
+	__m512i a = S[0];
+	__m512i b = S[1];
+	__m512i c = S[2];
+	__m512i d = S[3];
+	__m512i e = S[4];
+	__m512i f = S[5];
+	__m512i g = S[6];
+	__m512i h = S[7];
+
+	for(uint8_t r = 0; r < 64; r++)
+	{
+		if(r >= 16)
+		{
+			W[r % 16] = _mm512_add_epi32(_mm512_add_epi32(s1_512(W[(r - 2) % 16]), W[(r - 7) % 16]), _mm512_add_epi32(s0_512(W[(r - 15) % 16]), W[r % 16]));
+		}
+
+		__m512i T1 = _mm512_add_epi32(_mm512_add_epi32(h, S1_512(e)), _mm512_add_epi32(Ch512(e, f, g), _mm512_add_epi32(_mm512_set1_epi32(K[r]), W[r % 16])));
+		__m512i T2 = _mm512_add_epi32(S0_512(a), Maj512(a, b, c));
+		h = g;
+		g = f;
+		f = e;
+		e = _mm512_add_epi32(d, T1);
+		d = c;
+		c = b;
+		b = a;
+		a = _mm512_add_epi32(T1, T2);
+	}
+
+	_mm512_store_si512((void *) state[0], _mm512_add_epi32(a, S[0]));
+	_mm512_store_si512((void *) state[1], _mm512_add_epi32(b, S[1]));
+	_mm512_store_si512((void *) state[2], _mm512_add_epi32(c, S[2]));
+	_mm512_store_si512((void *) state[3], _mm512_add_epi32(d, S[3]));
+	_mm512_store_si512((void *) state[4], _mm512_add_epi32(e, S[4]));
+	_mm512_store_si512((void *) state[5], _mm512_add_epi32(f, S[5]));
+	_mm512_store_si512((void *) state[6], _mm512_add_epi32(g, S[6]));
+	_mm512_store_si512((void *) state[7], _mm512_add_epi32(h, S[7]));
+}
+
+#endif
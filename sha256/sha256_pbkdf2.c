@@ -0,0 +1,142 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha256_pbkdf2.c - PBKDF2-HMAC-SHA256 running independent chains in the multi-buffer lanes
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+//For explicit_bzero
+#define _DEFAULT_SOURCE
+#include "sha256_stats.h"
+
+//Chains kept in flight at once; every array below lives on the stack
+#define WINDOW 64
+
+//U_1 = HMAC(P, salt || INT(i)); the block is left holding U_1 and the padding for a 96-byte message
+static void first_block(const SHA256HMACKey* key, const void* salt, size_t salt_length, uint32_t index, uint8_t block[64])
+{
+	uint8_t counter[4] = { (uint8_t) (index >> 24), (uint8_t) (index >> 16), (uint8_t) (index >> 8), (uint8_t) index };
+	Context ctx;
+
+	sha256_hmac_init(&ctx, key);
+	sha256_update(&ctx, salt, salt_length);
+	sha256_update(&ctx, counter, 4);
+	sha256_hmac_final(&ctx, key, block);
+
+	memset(block + 32, 0, 32);
+	*(block + 32) = 128;
+	*(block + 62) = 0x03;
+}
+
+static void store_words(uint8_t block[64], const uint32_t hashes[8])
+{
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		*(block + 4 * i) = (uint8_t) (hashes[i] >> 24);
+		*(block + 4 * i + 1) = (uint8_t) (hashes[i] >> 16);
+		*(block + 4 * i + 2) = (uint8_t) (hashes[i] >> 8);
+		*(block + 4 * i + 3) = (uint8_t) (hashes[i]);
+	}
+}
+
+//Each iteration is two compressions per chain from the cached midstates; the padding is never rebuilt
+static void iterate(const SHA256HMACKey* const* keys, uint8_t (*blocks)[64], uint8_t (*T)[32], size_t count, uint32_t iterations)
+{
+	uint32_t state[WINDOW][8];
+	const uint8_t* pointers[WINDOW];
+
+	for(size_t i = 0; i < count; i++)
+	{
+		pointers[i] = blocks[i];
+		memcpy(T[i], blocks[i], 32);
+	}
+
+	for(uint32_t j = 1; j < iterations; j++)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			memcpy(state[i], keys[i]->inner, 32);
+		}
+		sha256_compress_many(state[0], pointers, count);
+
+		for(size_t i = 0; i < count; i++)
+		{
+			store_words(blocks[i], state[i]);
+			memcpy(state[i], keys[i]->outer, 32);
+		}
+		sha256_compress_many(state[0], pointers, count);
+
+		for(size_t i = 0; i < count; i++)
+		{
+			store_words(blocks[i], state[i]);
+			for(uint8_t k = 0; k < 32; k++)
+			{
+				T[i][k] ^= blocks[i][k];
+			}
+		}
+	}
+}
+
+int sha256_pbkdf2_many(const uint8_t* const* passwords, const size_t* password_lengths, size_t count, const void* salt, size_t salt_length, uint32_t iterations, uint8_t* keys, size_t key_length)
+{
+	SHA256HMACKey hmac_keys[WINDOW];
+	const SHA256HMACKey* chain_keys[WINDOW];
+	uint8_t blocks[WINDOW][64];
+	uint8_t T[WINDOW][32];
+	size_t blocks_per_key = (key_length + 31) / 32;
+	size_t total = count * blocks_per_key;
+	STATS_START();
+
+	//PBKDF2 defines at least one iteration; zero is a caller error, not a request for the weakest key
+	if(iterations == 0)
+	{
+		STATS_STOP(SHA256_ENTRY_PBKDF2, 0);
+		return -1;
+	}
+
+	//Chains are numbered password-major; a window may cover several passwords and part of another
+	for(size_t start = 0; start < total; start += WINDOW)
+	{
+		size_t window = total - start < WINDOW ? total - start : WINDOW;
+		size_t first_password = start / blocks_per_key;
+
+		for(size_t c = 0; c < window; c++)
+		{
+			size_t chain = start + c;
+			size_t password = chain / blocks_per_key;
+			SHA256HMACKey* key = &hmac_keys[password - first_password];
+
+			if(c == 0 || chain % blocks_per_key == 0)
+			{
+				sha256_hmac_key(key, passwords[password], password_lengths[password]);
+			}
+
+			chain_keys[c] = key;
+			first_block(key, salt, salt_length, (uint32_t) (chain % blocks_per_key) + 1, blocks[c]);
+		}
+
+		iterate(chain_keys, blocks, T, window, iterations);
+
+		for(size_t c = 0; c < window; c++)
+		{
+			size_t chain = start + c;
+			size_t offset = chain % blocks_per_key * 32;
+			size_t length = key_length - offset < 32 ? key_length - offset : 32;
+
+			memcpy(keys + chain / blocks_per_key * key_length + offset, T[c], length);
+		}
+	}
+
+	//These are dead stores to the compiler, which may drop a plain memset
+	explicit_bzero(hmac_keys, sizeof(hmac_keys));
+	explicit_bzero(blocks, sizeof(blocks));
+	explicit_bzero(T, sizeof(T));
+	STATS_STOP(SHA256_ENTRY_PBKDF2, (uint64_t) count * key_length);
+	return 0;
+}
+
+int sha256_pbkdf2(const void* password, size_t password_length, const void* salt, size_t salt_length, uint32_t iterations, uint8_t* key, size_t key_length)
+{
+	const uint8_t* passwords[1] = { (const uint8_t *) password };
+
+	return sha256_pbkdf2_many(passwords, &password_length, 1, salt, salt_length, iterations, key, key_length);
+}
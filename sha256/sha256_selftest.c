@@ -0,0 +1,305 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha256_selftest.c - Known-answer tests run against every compression and multi-buffer backend
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include "sha256.h"
+
+typedef struct SHA256KnownAnswer{
+	const char* message;
+	size_t repeat;
+	const char* digest;
+} KnownAnswer;
+
+//FIPS 180 examples; the last one is the long message of one million 'a'
+static const KnownAnswer fips_vectors[] = {
+	{ "", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+	{ "abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+	{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+	{ "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1, "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+	{ "aaaaaaaaaa", 100000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" }
+};
+
+//Messages of byte i = i % 251 around the padding cutoffs: 55 bytes still fit the length in the same block, 56 do not
+#define BOUNDARY_MAX 1000
+static const size_t boundary_lengths[] = { 0, 1, 55, 56, 57, 63, 64, 65, 119, 120, 127, 128, 1000 };
+static const char* const boundary_digests[] = {
+	"e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+	"6e340b9cffb37a989ca544e6bb780a2c78901d3fb33738768511a30617afa01d",
+	"463eb28e72f82e0a96c0a4cc53690c571281131f672aa229e0d45ae59b598b59",
+	"da2ae4d6b36748f2a318f23e7ab1dfdf45acdc9d049bd80e59de82a60895f562",
+	"2fe741af801cc238602ac0ec6a7b0c3a8a87c7fc7d7f02a3fe03d1c12eac4d8f",
+	"29af2686fd53374a36b0846694cc342177e428d1647515f078784d69cdb9e488",
+	"fdeab9acf3710362bd2658cdc9a29e8f9c757fcf9811603a8c447cd1d9151108",
+	"4bfd2c8b6f1eec7a2afeb48b934ee4b2694182027e6d0fc075074f2fabb31781",
+	"da18797ed7c3a777f0847f429724a2d8cd5138e6ed2895c3fa1a6d39d18f7ec6",
+	"f52b23db1fbb6ded89ef42a23ce0c8922c45f25c50b568a93bf1c075420bbb7c",
+	"92ca0fa6651ee2f97b884b7246a562fa71250fedefe5ebf270d31c546bfea976",
+	"471fb943aa23c511f6f72f8d1652d9c880cfa392ad80503120547703e56a2be5",
+	"4e4c294b331f7a2099a379bec34b9f9fc03dc46ab465d998f4d683da53487e6d"
+};
+#define NUMBER_OF_BOUNDARIES (sizeof(boundary_lengths) / sizeof(boundary_lengths[0]))
+
+//SHAVS Monte Carlo procedure: 100 checkpoints of 1000 chained hashes of MD[i-3] || MD[i-2] || MD[i-1].
+//The seed is SHA256("crypto_algorithms monte carlo seed"); the answer is checkpoint 99.
+static const char monte_carlo_seed[] = "fdb875d94b92312cda975f45bd197f44c49178fb221d5dc3434c998e37b9948a";
+static const char monte_carlo_digest[] = "89108dd1e5cb5635c08f751c1cfd079bd60e9f86be936a4d509c2bd310576e43";
+
+static int mismatch(const uint8_t digest[32], const char* expected)
+{
+	char hex[65];
+
+	sha256_to_hex(digest, hex);
+	return strcmp(hex, expected) != 0;
+}
+
+static int fips_tests(void)
+{
+	int failures = 0;
+
+	for(size_t v = 0; v < sizeof(fips_vectors) / sizeof(fips_vectors[0]); v++)
+	{
+		size_t length = strlen(fips_vectors[v].message);
+		uint8_t digest[32];
+		Context ctx;
+
+		sha256_init(&ctx);
+		for(size_t r = 0; r < fips_vectors[v].repeat; r++)
+		{
+			sha256_update(&ctx, fips_vectors[v].message, length);
+		}
+		sha256_final(&ctx, digest);
+		failures += mismatch(digest, fips_vectors[v].digest);
+
+		if(fips_vectors[v].repeat == 1)
+		{
+			sha256_digest(fips_vectors[v].message, length, digest);
+			failures += mismatch(digest, fips_vectors[v].digest);
+		}
+	}
+
+	return failures;
+}
+
+//Each boundary message goes through the one-shot path and byte by byte through the buffered path
+static int boundary_tests(const uint8_t* pattern)
+{
+	int failures = 0;
+
+	for(size_t v = 0; v < NUMBER_OF_BOUNDARIES; v++)
+	{
+		uint8_t digest[32];
+		Context ctx;
+
+		sha256_digest(pattern, boundary_lengths[v], digest);
+		failures += mismatch(digest, boundary_digests[v]);
+
+		sha256_init(&ctx);
+		for(size_t i = 0; i < boundary_lengths[v]; i++)
+		{
+			sha256_update(&ctx, pattern + i, 1);
+		}
+		sha256_final(&ctx, digest);
+		failures += mismatch(digest, boundary_digests[v]);
+	}
+
+	return failures;
+}
+
+static int monte_carlo_test(void)
+{
+	uint8_t md[3][32];
+	uint8_t seed[32];
+	uint8_t message[96];
+
+	for(uint8_t i = 0; i < 32; i++)
+	{
+		char byte[3] = { monte_carlo_seed[2 * i], monte_carlo_seed[2 * i + 1], 0 };
+		seed[i] = (uint8_t) strtoul(byte, NULL, 16);
+	}
+
+	for(uint8_t j = 0; j < 100; j++)
+	{
+		memcpy(md[0], seed, 32);
+		memcpy(md[1], seed, 32);
+		memcpy(md[2], seed, 32);
+
+		for(uint16_t i = 3; i < 1003; i++)
+		{
+			memcpy(message, md[0], 32);
+			memcpy(message + 32, md[1], 32);
+			memcpy(message + 64, md[2], 32);
+			memmove(md[0], md[1], 64);
+			sha256_digest(message, 96, md[2]);
+		}
+
+		memcpy(seed, md[2], 32);
+	}
+
+	return mismatch(seed, monte_carlo_digest);
+}
+
+//The whole boundary set in one batch is more messages than lanes, so lanes are refilled mid-batch
+static int many_tests(const uint8_t* pattern)
+{
+	const uint8_t* messages[NUMBER_OF_BOUNDARIES];
+	size_t suffix_lengths[NUMBER_OF_BOUNDARIES - 1];
+	uint8_t digests[32 * NUMBER_OF_BOUNDARIES];
+	int failures = 0;
+	Context prefix;
+
+	for(size_t v = 0; v < NUMBER_OF_BOUNDARIES; v++)
+	{
+		messages[v] = pattern;
+	}
+
+	sha256_hash_many(messages, boundary_lengths, NUMBER_OF_BOUNDARIES, digests);
+	for(size_t v = 0; v < NUMBER_OF_BOUNDARIES; v++)
+	{
+		failures += mismatch(digests + 32 * v, boundary_digests[v]);
+	}
+
+	//A one-byte prefix leaves a partial block buffered, so every lane starts from a staged first block
+	for(size_t v = 1; v < NUMBER_OF_BOUNDARIES; v++)
+	{
+		messages[v - 1] = pattern + 1;
+		suffix_lengths[v - 1] = boundary_lengths[v] - 1;
+	}
+	sha256_init(&prefix);
+	sha256_update(&prefix, pattern, 1);
+
+	sha256_hash_many_after(&prefix, messages, suffix_lengths, NUMBER_OF_BOUNDARIES - 1, digests);
+	for(size_t v = 1; v < NUMBER_OF_BOUNDARIES; v++)
+	{
+		failures += mismatch(digests + 32 * (v - 1), boundary_digests[v]);
+	}
+
+	return failures;
+}
+
+//sha256d must agree with two passes of the general path, which the vectors above pin down
+static int double_tests(const uint8_t* pattern)
+{
+	uint8_t expected[32 * 15];
+	uint8_t digests[32 * 15];
+	uint8_t inner[32];
+	int failures = 0;
+
+	for(uint8_t length = 32; length <= 64; length += 32)
+	{
+		for(size_t i = 0; i < 15; i++)
+		{
+			sha256_digest(pattern + length * i, length, inner);
+			sha256_digest(inner, 32, expected + 32 * i);
+
+			if(length == 64)
+			{
+				sha256d_64(pattern + 64 * i, digests + 32 * i);
+			}
+			else
+			{
+				sha256d_32(pattern + 32 * i, digests + 32 * i);
+			}
+		}
+		failures += memcmp(digests, expected, sizeof(digests)) != 0;
+
+		if(length == 64)
+		{
+			sha256d_64_many(pattern, 15, digests);
+		}
+		else
+		{
+			sha256d_32_many(pattern, 15, digests);
+		}
+		failures += memcmp(digests, expected, sizeof(digests)) != 0;
+	}
+
+	return failures;
+}
+
+//Every boundary message is split at every shorter boundary length, checkpointed there and resumed in a fresh context;
+//a checkpoint with one byte changed must be refused
+static int checkpoint_tests(const uint8_t* pattern)
+{
+	int failures = 0;
+
+	for(size_t v = 0; v < NUMBER_OF_BOUNDARIES; v++)
+	{
+		for(size_t s = 0; s <= v; s++)
+		{
+			uint8_t checkpoint[SHA256_CHECKPOINT_SIZE];
+			uint8_t digest[32];
+			Context ctx;
+
+			sha256_init(&ctx);
+			sha256_update(&ctx, pattern, boundary_lengths[s]);
+			sha256_export(&ctx, checkpoint);
+
+			memset(&ctx, 0xa5, sizeof(Context));
+			if(sha256_import(&ctx, checkpoint) != 0)
+			{
+				failures++;
+				continue;
+			}
+			sha256_update(&ctx, pattern + boundary_lengths[s], boundary_lengths[v] - boundary_lengths[s]);
+			sha256_final(&ctx, digest);
+			failures += mismatch(digest, boundary_digests[v]);
+
+			*(checkpoint + (boundary_lengths[v] * 7) % SHA256_CHECKPOINT_SIZE) ^= 1;
+			failures += sha256_import(&ctx, checkpoint) != -1;
+		}
+	}
+
+	return failures;
+}
+
+static void fill_pattern(uint8_t* pattern)
+{
+	for(size_t i = 0; i < BOUNDARY_MAX; i++)
+	{
+		*(pattern + i) = (uint8_t) (i % 251);
+	}
+}
+
+int sha256_known_answers(void)
+{
+	uint8_t pattern[BOUNDARY_MAX];
+
+	fill_pattern(pattern);
+	return fips_tests() + boundary_tests(pattern) + monte_carlo_test() + checkpoint_tests(pattern) + many_tests(pattern) + double_tests(pattern);
+}
+
+int sha256_selftest(void)
+{
+	SHA256Backend backend = sha256_get_backend();
+	SHA256ManyBackend many_backend = sha256_get_many_backend();
+	uint8_t pattern[BOUNDARY_MAX];
+	int failures = 0;
+
+	fill_pattern(pattern);
+
+	for(SHA256Backend b = SHA256_BACKEND_SCALAR; b <= SHA256_BACKEND_SHANI; b++)
+	{
+		if(sha256_set_backend(b) == 0)
+		{
+			failures += fips_tests() + boundary_tests(pattern) + monte_carlo_test() + checkpoint_tests(pattern);
+		}
+	}
+
+	//Partial lane groups fall back to the compression backend, so every pairing is run
+	for(SHA256Backend b = SHA256_BACKEND_SCALAR; b <= SHA256_BACKEND_SHANI; b++)
+	{
+		for(SHA256ManyBackend m = SHA256_MANY_SERIAL; m <= SHA256_MANY_AVX512; m++)
+		{
+			if(sha256_set_backend(b) == 0 && sha256_set_many_backend(m) == 0)
+			{
+				failures += many_tests(pattern) + double_tests(pattern);
+			}
+		}
+	}
+
+	sha256_set_backend(backend);
+	sha256_set_many_backend(many_backend);
+	return failures;
+}
@@ -0,0 +1,86 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha256_shani.c - SHA256 compression function using the x86 SHA extensions
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include "sha256_stats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+//The state is kept as ABEF/CDGH pairs, which is the layout sha256rnds2 expects
+__attribute__((target("sha,sse4.1")))
+void sha256_compress_shani(uint32_t hashes[8], const uint8_t* blocks, uint64_t number_of_blocks)
+{
+	const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) hashes), 0xB1);
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (hashes + 4)), 0x1B);
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+	STATS_BLOCKS(SHA256_KERNEL_SHANI, number_of_blocks);
+
+	for(uint64_t i = 0; i < number_of_blocks; i++)
+	{
+		__m128i abef = state0;
+		__m128i cdgh = state1;
+		__m128i W[4];
+
+		for(uint8_t r = 0; r < 16; r++)
+		{
+			if(r < 4)
+			{
+				W[r] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (blocks + 64 * i + 16 * r)), byte_swap);
+			}
+			else
+			{
+				__m128i sum = _mm_add_epi32(_mm_sha256msg1_epu32(W[r % 4], W[(r + 1) % 4]), _mm_alignr_epi8(W[(r + 3) % 4], W[(r + 2) % 4], 4));
+				W[r % 4] = _mm_sha256msg2_epu32(sum, W[(r + 3) % 4]);
+			}
+
+			__m128i message = _mm_add_epi32(W[r % 4], _mm_loadu_si128((const __m128i *) (K + 4 * r)));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(message, 0x0E));
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	_mm_storeu_si128((__m128i *) hashes, _mm_blend_epi16(tmp, state1, 0xF0));
+	_mm_storeu_si128((__m128i *) (hashes + 4), _mm_alignr_epi8(state1, tmp, 8));
+}
+
+//64 rounds from a schedule expanded ahead of time with K already added, as for a constant padding block
+__attribute__((target("sha,sse4.1")))
+void sha256_rounds_shani(uint32_t hashes[8], const uint32_t WK[64])
+{
+	__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) hashes), 0xB1);
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) (hashes + 4)), 0x1B);
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+	STATS_BLOCKS(SHA256_KERNEL_SHANI, 1);
+
+	__m128i abef = state0;
+	__m128i cdgh = state1;
+
+	for(uint8_t r = 0; r < 16; r++)
+	{
+		__m128i message = _mm_loadu_si128((const __m128i *) (WK + 4 * r));
+		state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+		state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(message, 0x0E));
+	}
+
+	state0 = _mm_add_epi32(state0, abef);
+	state1 = _mm_add_epi32(state1, cdgh);
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	_mm_storeu_si128((__m128i *) hashes, _mm_blend_epi16(tmp, state1, 0xF0));
+	_mm_storeu_si128((__m128i *) (hashes + 4), _mm_alignr_epi8(state1, tmp, 8));
+}
+
+#endif
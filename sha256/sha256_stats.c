@@ -0,0 +1,152 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha256_stats.c - Per-thread counters and latency histograms, summed on demand
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include "sha256_stats.h"
+
+#ifdef SHA256_STATS
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+//Only the owning thread writes a record, so plain relaxed loads and stores are enough and no update is a locked instruction
+typedef struct SHA256ThreadStats{
+	struct SHA256ThreadStats* next;
+	atomic_int in_use;
+	_Atomic uint64_t blocks[SHA256_KERNELS];
+	_Atomic uint64_t calls[SHA256_ENTRIES];
+	_Atomic uint64_t bytes[SHA256_ENTRIES];
+	_Atomic uint64_t latency[SHA256_ENTRIES][SHA256_STATS_BUCKETS];
+} ThreadStats;
+
+static _Atomic(ThreadStats *) all_stats;
+static _Thread_local ThreadStats* local_stats;
+static pthread_key_t release_key;
+static pthread_once_t release_once = PTHREAD_ONCE_INIT;
+
+#define bump(counter, n) atomic_store_explicit(&(counter), atomic_load_explicit(&(counter), memory_order_relaxed) + (n), memory_order_relaxed)
+
+//A record outlives its thread and is handed to the next new thread, so totals never go backwards
+static void release_stats(void* stats)
+{
+	atomic_store(&((ThreadStats *) stats)->in_use, 0);
+}
+
+static void create_release_key(void)
+{
+	pthread_key_create(&release_key, release_stats);
+}
+
+static ThreadStats* thread_stats(void)
+{
+	if(local_stats != NULL)
+	{
+		return local_stats;
+	}
+
+	ThreadStats* stats;
+
+	for(stats = atomic_load(&all_stats); stats != NULL; stats = stats->next)
+	{
+		int unused = 0;
+		if(atomic_compare_exchange_strong(&stats->in_use, &unused, 1))
+		{
+			break;
+		}
+	}
+
+	if(stats == NULL)
+	{
+		stats = (ThreadStats *) calloc(1, sizeof(ThreadStats));
+		if(stats == NULL)
+		{
+			return NULL;
+		}
+		atomic_init(&stats->in_use, 1);
+		stats->next = atomic_load(&all_stats);
+		while(!atomic_compare_exchange_weak(&all_stats, &stats->next, stats))
+		{
+		}
+	}
+
+	pthread_once(&release_once, create_release_key);
+	pthread_setspecific(release_key, stats);
+	local_stats = stats;
+	return stats;
+}
+
+uint64_t sha256_stats_clock(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+void sha256_stats_record(SHA256StatsEntry entry, uint64_t bytes, uint64_t start)
+{
+	uint64_t elapsed = sha256_stats_clock() - start;
+	ThreadStats* stats = thread_stats();
+	uint8_t bucket = (uint8_t) (63 - __builtin_clzll(elapsed | 1));
+
+	if(stats == NULL)
+	{
+		return;
+	}
+	if(bucket >= SHA256_STATS_BUCKETS)
+	{
+		bucket = SHA256_STATS_BUCKETS - 1;
+	}
+
+	bump(stats->calls[entry], 1);
+	bump(stats->bytes[entry], bytes);
+	bump(stats->latency[entry][bucket], 1);
+}
+
+void sha256_stats_blocks(SHA256StatsKernel kernel, uint64_t blocks)
+{
+	ThreadStats* stats = thread_stats();
+
+	if(stats != NULL)
+	{
+		bump(stats->blocks[kernel], blocks);
+	}
+}
+
+int sha256_stats_snapshot(SHA256Stats* snapshot)
+{
+	memset(snapshot, 0, sizeof(SHA256Stats));
+	snapshot->backend = sha256_get_backend();
+	snapshot->many_backend = sha256_get_many_backend();
+
+	for(ThreadStats* stats = atomic_load(&all_stats); stats != NULL; stats = stats->next)
+	{
+		for(uint8_t k = 0; k < SHA256_KERNELS; k++)
+		{
+			snapshot->blocks[k] += atomic_load_explicit(&stats->blocks[k], memory_order_relaxed);
+		}
+
+		for(uint8_t e = 0; e < SHA256_ENTRIES; e++)
+		{
+			snapshot->entries[e].calls += atomic_load_explicit(&stats->calls[e], memory_order_relaxed);
+			snapshot->entries[e].bytes += atomic_load_explicit(&stats->bytes[e], memory_order_relaxed);
+			for(uint8_t b = 0; b < SHA256_STATS_BUCKETS; b++)
+			{
+				snapshot->entries[e].latency[b] += atomic_load_explicit(&stats->latency[e][b], memory_order_relaxed);
+			}
+		}
+	}
+
+	return 0;
+}
+
+#else
+
+int sha256_stats_snapshot(SHA256Stats* snapshot)
+{
+	memset(snapshot, 0, sizeof(SHA256Stats));
+	return -1;
+}
+
+#endif
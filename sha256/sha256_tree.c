@@ -0,0 +1,120 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha256_tree.c - Parallel tree hashing mode built on the SHA256 compression function
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include "sha256_stats.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#define DEFAULT_CHUNK_SIZE (1 << 20)
+
+typedef struct SHA256TreeJob{
+	const uint8_t* data;
+	size_t length;
+	size_t chunk_size;
+	size_t number_of_chunks;
+	atomic_size_t next_chunk;
+	uint8_t* leaves;
+} TreeJob;
+
+//Every leaf and the root start with one whole header block, which keeps the data block-aligned
+static void header_block(uint8_t block[64], uint8_t tag, uint64_t first, uint64_t second)
+{
+	memset(block, 0, 64);
+	*(block) = tag;
+	*(block + 1) = SHA256_TREE_VERSION;
+
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		*(block + 9 - i) = (uint8_t) (first >> (8 * i));
+		*(block + 17 - i) = (uint8_t) (second >> (8 * i));
+	}
+}
+
+//Workers claim chunks from a shared counter, so a slow core never holds chunks another core could take
+static void* hash_chunks(void* argument)
+{
+	TreeJob* job = (TreeJob *) argument;
+	size_t i;
+
+	while((i = atomic_fetch_add(&job->next_chunk, 1)) < job->number_of_chunks)
+	{
+		size_t offset = i * job->chunk_size;
+		size_t length = job->length - offset < job->chunk_size ? job->length - offset : job->chunk_size;
+		uint8_t header[64];
+		Context ctx;
+
+		header_block(header, 0, i, length);
+		sha256_init(&ctx);
+		sha256_update(&ctx, header, 64);
+		sha256_update(&ctx, job->data + offset, length);
+		sha256_final(&ctx, job->leaves + 32 * i);
+	}
+
+	return NULL;
+}
+
+int sha256_tree_hash(const void* data, size_t length, const SHA256TreeParams* params, uint8_t digest[32])
+{
+	TreeJob job;
+	size_t threads = params != NULL ? params->threads : 0;
+	STATS_START();
+
+	job.data = (const uint8_t *) data;
+	job.length = length;
+	job.chunk_size = params != NULL && params->chunk_size > 0 ? params->chunk_size : DEFAULT_CHUNK_SIZE;
+	job.number_of_chunks = length == 0 ? 1 : (length - 1) / job.chunk_size + 1;
+	atomic_init(&job.next_chunk, 0);
+	job.leaves = (uint8_t *) malloc(32 * job.number_of_chunks);
+
+	if(job.leaves == NULL)
+	{
+		STATS_STOP(SHA256_ENTRY_TREE_HASH, 0);
+		return -1;
+	}
+
+	if(threads == 0)
+	{
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = online > 0 ? (size_t) online : 1;
+	}
+	if(threads > job.number_of_chunks)
+	{
+		threads = job.number_of_chunks;
+	}
+
+	pthread_t* workers = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+	size_t started = 0;
+
+	if(workers != NULL)
+	{
+		while(started + 1 < threads && pthread_create(&workers[started], NULL, hash_chunks, &job) == 0)
+		{
+			started++;
+		}
+	}
+
+	hash_chunks(&job);
+
+	for(size_t i = 0; i < started; i++)
+	{
+		pthread_join(workers[i], NULL);
+	}
+	free(workers);
+
+	uint8_t header[64];
+	Context ctx;
+
+	header_block(header, 1, job.chunk_size, length);
+	sha256_init(&ctx);
+	sha256_update(&ctx, header, 64);
+	sha256_update(&ctx, job.leaves, 32 * job.number_of_chunks);
+	sha256_final(&ctx, digest);
+
+	free(job.leaves);
+	STATS_STOP(SHA256_ENTRY_TREE_HASH, length);
+	return 0;
+}
@@ -0,0 +1,290 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha256d.c - SHA256(SHA256(x)) for fixed 32- and 64-byte inputs with the padding schedules precomputed
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include "sha256_stats.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+void sha256_rounds_shani(uint32_t hashes[8], const uint32_t WK[64]);
+#endif
+
+//Chains kept in flight at once by the batched variants; every array below lives on the stack
+#define WINDOW 64
+
+static const uint32_t initial_hashes[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+//W + K of the block that pads a 64-byte message; it is the same for every input
+static const uint32_t padding_64[64] = {
+	0xc28a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+	0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf374,
+	0x649b69c1,0xf0fe4786,0x0fe1edc6,0x240cf254,0x4fe9346f,0x6cc984be,0x61b9411e,0x16f988fa,
+	0xf2c65152,0xa88e5a6d,0xb019fc65,0xb9d99ec7,0x9a1231c3,0xe70eeaa0,0xfdb1232b,0xc7353eb0,
+	0x3069bad5,0xcb976d5f,0x5a0f118f,0xdc1eeefd,0x0a35b689,0xde0b7a04,0x58f4ca9d,0xe15d5b16,
+	0x007f3e86,0x37088980,0xa507ea32,0x6fab9537,0x17406110,0x0d8cd6f1,0xcdaa3b6d,0xc0bbbe37,
+	0x83613bda,0xdb48a363,0x0b02e931,0x6fd15ca7,0x521afaca,0x31338431,0x6ed41a95,0x6d437890,
+	0xc39c91f2,0x9eccabbd,0xb5c9a0e6,0x532fb63c,0xd2c741c6,0x07237ea3,0xa4954b68,0x4c191d76
+};
+
+//The same padding block as bytes, for the lanes, which expand their own schedules
+static const uint8_t padding_block_64[64] = { [0] = 0x80, [62] = 0x02 };
+
+static void rounds_scalar(uint32_t hashes[8], const uint32_t WK[64])
+{
+	uint32_t a = hashes[0];
+	uint32_t b = hashes[1];
+	uint32_t c = hashes[2];
+	uint32_t d = hashes[3];
+	uint32_t e = hashes[4];
+	uint32_t f = hashes[5];
+	uint32_t g = hashes[6];
+	uint32_t h = hashes[7];
+
+	STATS_BLOCKS(SHA256_KERNEL_SCALAR, 1);
+
+	for(uint8_t r = 0; r < 64; r++)
+	{
+		uint32_t T1 = h + S1(e) + Ch(e, f, g) + WK[r];
+		uint32_t T2 = S0(a) + Maj(a, b, c);
+		h = g;
+		g = f;
+		f = e;
+		e = d + T1;
+		d = c;
+		c = b;
+		b = a;
+		a = T1 + T2;
+	}
+
+	hashes[0] += a;
+	hashes[1] += b;
+	hashes[2] += c;
+	hashes[3] += d;
+	hashes[4] += e;
+	hashes[5] += f;
+	hashes[6] += g;
+	hashes[7] += h;
+}
+
+static void rounds(uint32_t hashes[8], const uint32_t WK[64])
+{
+#if defined(__x86_64__) || defined(__i386__)
+	if(sha256_get_backend() == SHA256_BACKEND_SHANI)
+	{
+		sha256_rounds_shani(hashes, WK);
+		return;
+	}
+#endif
+	rounds_scalar(hashes, WK);
+}
+
+//A 32-byte message followed by its padding; words 8..15 are constant
+static void block_32(uint8_t block[64], const uint32_t words[8])
+{
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		*(block + 4 * i) = (uint8_t) (words[i] >> 24);
+		*(block + 4 * i + 1) = (uint8_t) (words[i] >> 16);
+		*(block + 4 * i + 2) = (uint8_t) (words[i] >> 8);
+		*(block + 4 * i + 3) = (uint8_t) (words[i]);
+	}
+
+	memset(block + 32, 0, 32);
+	*(block + 32) = 128;
+	*(block + 62) = 0x01;
+}
+
+//SHA256 of the 32-byte message held in words. Without SHA-NI the terms of the schedule that only
+//involve the constant padding words are folded away; with it, msg1/msg2 expand the block faster.
+static void hash_32(const uint32_t words[8], uint32_t digest[8])
+{
+	const uint32_t one = 0x80000000;
+	const uint32_t length = 256;
+	uint32_t W[64];
+
+	memcpy(digest, initial_hashes, 32);
+
+#if defined(__x86_64__) || defined(__i386__)
+	if(sha256_get_backend() == SHA256_BACKEND_SHANI)
+	{
+		uint8_t block[64];
+
+		block_32(block, words);
+		sha256_compress(digest, block, 1);
+		return;
+	}
+#endif
+
+	memcpy(W, words, 32);
+	W[8] = one;
+	memset(W + 9, 0, 24);
+	W[15] = length;
+	W[16] = s0(W[1]) + W[0];
+	W[17] = s1(length) + s0(W[2]) + W[1];
+	W[18] = s1(W[16]) + s0(W[3]) + W[2];
+	W[19] = s1(W[17]) + s0(W[4]) + W[3];
+	W[20] = s1(W[18]) + s0(W[5]) + W[4];
+	W[21] = s1(W[19]) + s0(W[6]) + W[5];
+	W[22] = s1(W[20]) + length + s0(W[7]) + W[6];
+	W[23] = s1(W[21]) + W[16] + s0(one) + W[7];
+	W[24] = s1(W[22]) + W[17] + one;
+	W[25] = s1(W[23]) + W[18];
+	W[26] = s1(W[24]) + W[19];
+	W[27] = s1(W[25]) + W[20];
+	W[28] = s1(W[26]) + W[21];
+	W[29] = s1(W[27]) + W[22];
+	W[30] = s1(W[28]) + W[23] + s0(length);
+	W[31] = s1(W[29]) + W[24] + s0(W[16]) + length;
+
+	for(uint8_t j = 32; j < 64; j++)
+	{
+		W[j] = s1(W[j - 2]) + W[j - 7] + s0(W[j - 15]) + W[j - 16];
+	}
+
+	for(uint8_t r = 0; r < 64; r++)
+	{
+		W[r] += K[r];
+	}
+
+	rounds_scalar(digest, W);
+}
+
+static void load_words(uint32_t words[8], const uint8_t* bytes)
+{
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		words[i] = (((uint32_t) *(bytes + 4 * i)) << 24) | (((uint32_t) *(bytes + 4 * i + 1)) << 16) | (((uint32_t) *(bytes + 4 * i + 2)) << 8) | ((uint32_t) *(bytes + 4 * i + 3));
+	}
+}
+
+static void store_words(uint8_t digest[32], const uint32_t words[8])
+{
+	for(uint8_t i = 0; i < 8; i++)
+	{
+		*(digest + 4 * i) = (uint8_t) (words[i] >> 24);
+		*(digest + 4 * i + 1) = (uint8_t) (words[i] >> 16);
+		*(digest + 4 * i + 2) = (uint8_t) (words[i] >> 8);
+		*(digest + 4 * i + 3) = (uint8_t) (words[i]);
+	}
+}
+
+void sha256d_64(const uint8_t input[64], uint8_t digest[32])
+{
+	uint32_t state[8];
+	uint32_t result[8];
+	STATS_START();
+
+	memcpy(state, initial_hashes, 32);
+	sha256_compress(state, input, 1);
+	rounds(state, padding_64);
+	hash_32(state, result);
+	store_words(digest, result);
+	STATS_STOP(SHA256_ENTRY_DOUBLE, 64);
+}
+
+void sha256d_32(const uint8_t input[32], uint8_t digest[32])
+{
+	uint32_t words[8];
+	uint32_t state[8];
+	STATS_START();
+
+	load_words(words, input);
+	hash_32(words, state);
+	hash_32(state, words);
+	store_words(digest, words);
+	STATS_STOP(SHA256_ENTRY_DOUBLE, 32);
+}
+
+//Every step is one block per chain, so each goes through the lanes as one sha256_compress_many call
+static void many(const uint8_t* inputs, size_t input_length, size_t count, uint8_t* digests)
+{
+	uint32_t state[WINDOW][8];
+	uint8_t blocks[WINDOW][64];
+	const uint8_t* pointers[WINDOW];
+
+	for(size_t done = 0; done < count; done += WINDOW)
+	{
+		size_t window = count - done < WINDOW ? count - done : WINDOW;
+
+		for(size_t i = 0; i < window; i++)
+		{
+			memcpy(state[i], initial_hashes, 32);
+			if(input_length == 64)
+			{
+				pointers[i] = inputs + 64 * (done + i);
+			}
+			else
+			{
+				memcpy(blocks[i], inputs + 32 * (done + i), 32);
+				memset(blocks[i] + 32, 0, 32);
+				*(blocks[i] + 32) = 128;
+				*(blocks[i] + 62) = 0x01;
+				pointers[i] = blocks[i];
+			}
+		}
+		sha256_compress_many(state[0], pointers, window);
+
+		if(input_length == 64)
+		{
+			for(size_t i = 0; i < window; i++)
+			{
+				pointers[i] = padding_block_64;
+			}
+			sha256_compress_many(state[0], pointers, window);
+		}
+
+		for(size_t i = 0; i < window; i++)
+		{
+			block_32(blocks[i], state[i]);
+			memcpy(state[i], initial_hashes, 32);
+			pointers[i] = blocks[i];
+		}
+		sha256_compress_many(state[0], pointers, window);
+
+		for(size_t i = 0; i < window; i++)
+		{
+			store_words(digests + 32 * (done + i), state[i]);
+		}
+	}
+}
+
+void sha256d_64_many(const uint8_t* inputs, size_t count, uint8_t* digests)
+{
+	STATS_START();
+
+	if(sha256_get_many_backend() == SHA256_MANY_SERIAL)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			sha256d_64(inputs + 64 * i, digests + 32 * i);
+		}
+	}
+	else
+	{
+		many(inputs, 64, count, digests);
+	}
+
+	STATS_STOP(SHA256_ENTRY_DOUBLE, 64 * (uint64_t) count);
+}
+
+void sha256d_32_many(const uint8_t* inputs, size_t count, uint8_t* digests)
+{
+	STATS_START();
+
+	if(sha256_get_many_backend() == SHA256_MANY_SERIAL)
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			sha256d_32(inputs + 32 * i, digests + 32 * i);
+		}
+	}
+	else
+	{
+		many(inputs, 32, count, digests);
+	}
+
+	STATS_STOP(SHA256_ENTRY_DOUBLE, 32 * (uint64_t) count);
+}
@@ -48,23 +48,175 @@ static const uint64_t K[80] = {
 	0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
 };
 
+typedef enum SHA512Backend{
+	SHA512_BACKEND_AUTO,
+	SHA512_BACKEND_SCALAR,
+	SHA512_BACKEND_AVX2
+} SHA512Backend;
+
+//Tree hashing mode, version 1:
+//  leaf i = SHA512(header(0, version, i, length of chunk i) || chunk i)
+//  root   = SHA512(header(1, version, chunk_size, total length) || leaf 0 || leaf 1 || ...)
+//header is one 128-byte block: tag, version, then two big-endian 64-bit fields, zero filled.
+//The root depends only on the data and chunk_size, never on the number of threads.
+#define SHA512_TREE_VERSION 1
+
+typedef struct SHA512TreeParams{
+	size_t chunk_size;
+	unsigned threads;
+} SHA512TreeParams;
+
+//Merkle tree: leaf = SHA512(0x00 || data), node = SHA512(0x01 || left || right), and the last node of
+//an odd-sized level is promoted unchanged, which gives the same root as RFC 6962. The capacity is a power
+//of two and level l starts at node 2 * capacity - 2 * (capacity >> l). A zeroed struct is an empty tree.
+typedef struct SHA512Merkle{
+    uint8_t* nodes;
+    size_t number_of_leaves;
+    size_t capacity;
+} SHA512Merkle;
+
+//Chaining states after the ipad and opad blocks; set up once per key with sha512_hmac_key
+typedef struct SHA512HMACKey{
+	uint64_t inner[8];
+	uint64_t outer[8];
+} SHA512HMACKey;
+
+//Instrumentation, compiled in with -DSHA512_STATS; without it nothing is counted and the snapshot fails.
+//Entry latencies are inclusive, so sha512_hash also shows up under DIGEST, FINAL and TO_HEX.
+typedef enum SHA512StatsEntry{
+    SHA512_ENTRY_UPDATE,
+    SHA512_ENTRY_FINAL,
+    SHA512_ENTRY_DIGEST,
+    SHA512_ENTRY_TO_HEX,
+    SHA512_ENTRY_HASH,
+    SHA512_ENTRY_HASH_MANY,
+    SHA512_ENTRY_HMAC,
+    SHA512_ENTRY_PBKDF2,
+    SHA512_ENTRY_TREE_HASH,
+    SHA512_ENTRY_MERKLE,
+    SHA512_ENTRIES
+} SHA512StatsEntry;
+
+typedef enum SHA512StatsKernel{
+    SHA512_KERNEL_SCALAR,
+    SHA512_KERNEL_AVX2,
+    SHA512_KERNELS
+} SHA512StatsKernel;
+
+//latency[i] counts calls that took [2^i, 2^(i+1)) nanoseconds; the last bucket is open ended
+#define SHA512_STATS_BUCKETS 32
+
+typedef struct SHA512EntryStats{
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t latency[SHA512_STATS_BUCKETS];
+} SHA512EntryStats;
+
+//bytes is the message bytes hashed, or the key bytes derived for PBKDF2; a call that fails still counts, with no bytes
+typedef struct SHA512Stats{
+    SHA512Backend backend;
+    uint64_t blocks[SHA512_KERNELS];
+    SHA512EntryStats entries[SHA512_ENTRIES];
+} SHA512Stats;
+
 typedef struct SHA512Context{
-	const char* message;
     uint128_t length_in_bits;
-	uint16_t k;
-	uint128_t padded_length_in_bits;
-	uint8_t* padded;
+	uint8_t block[128];
+	uint8_t block_length;
 	uint64_t hashes[8];
 } Context;
 
-static void init_ctx(Context* ctx, const char* message);
+void sha512_init(Context* ctx);
 
-static void pad_ctx(Context* ctx);
+void sha512_update(Context* ctx, const void* data, size_t length);
 
-static void compute_hashes(Context* ctx);
+void sha512_final(Context* ctx, uint8_t digest[64]);
 
-inline static void destroy_ctx(Context* ctx);
+//A context is a self-contained snapshot of the chaining state, the buffered partial block and the length,
+//so hashing a shared prefix once and cloning it lets many messages resume from there
+void sha512_clone(Context* copy, const Context* ctx);
 
+//Hashes prefix || suffix without touching prefix
+void sha512_final_with(const Context* prefix, const void* suffix, size_t length, uint8_t digest[64]);
+
+//A checkpoint is a context as a fixed-size, big-endian record that can be stored and imported later, on any
+//machine, to resume hashing where it stopped; export before sha512_final, or take the digest with sha512_final_with
+#define SHA512_CHECKPOINT_SIZE 224
+#define SHA512_CHECKPOINT_VERSION 1
+
+void sha512_export(const Context* ctx, uint8_t checkpoint[SHA512_CHECKPOINT_SIZE]);
+
+//Returns -1 and leaves ctx untouched if the checkpoint is damaged, of another version or of another algorithm
+int sha512_import(Context* ctx, const uint8_t checkpoint[SHA512_CHECKPOINT_SIZE]);
+
+//Hashes prefix || messages[i] for every message, leaving prefix untouched; digests receives 64 * count bytes
+void sha512_hash_many_after(const Context* prefix, const uint8_t* const* messages, const size_t* lengths, size_t count, uint8_t* digests);
+
+//One-shot hash of length bytes; does not allocate
+void sha512_digest(const void* data, size_t length, uint8_t digest[64]);
+
+void sha512_to_hex(const uint8_t digest[64], char hex[129]);
+
+//buffer receives the NUL-terminated hex digest and must hold 129 bytes
 void sha512_hash(const char* message, char* buffer);
 
-#endif
+void sha512_hmac_key(SHA512HMACKey* key, const void* secret, size_t length);
+
+void sha512_hmac(const SHA512HMACKey* key, const void* data, size_t length, uint8_t mac[64]);
+
+//Streaming HMAC: sha512_hmac_init, any number of sha512_update calls, then sha512_hmac_final
+void sha512_hmac_init(Context* ctx, const SHA512HMACKey* key);
+
+void sha512_hmac_final(Context* ctx, const SHA512HMACKey* key, uint8_t mac[64]);
+
+//MACs count messages under one key; macs receives 64 * count bytes
+void sha512_hmac_many(const SHA512HMACKey* key, const uint8_t* const* messages, const size_t* lengths, size_t count, uint8_t* macs);
+
+//Derives key_length bytes; returns -1, leaving key untouched, when iterations is 0
+int sha512_pbkdf2(const void* password, size_t password_length, const void* salt, size_t salt_length, uint32_t iterations, uint8_t* key, size_t key_length);
+
+//Derives count keys of key_length bytes each, one per password, with the same salt and iteration count; returns -1 when iterations is 0
+int sha512_pbkdf2_many(const uint8_t* const* passwords, const size_t* password_lengths, size_t count, const void* salt, size_t salt_length, uint32_t iterations, uint8_t* keys, size_t key_length);
+
+//Sums the counters of every thread that has hashed so far; returns -1 when built without SHA512_STATS
+int sha512_stats_snapshot(SHA512Stats* stats);
+
+//Hashes every leaf, then every level as one batch spread over threads (0 means all online cores); returns -1 if out of memory.
+//tree must be zeroed or hold an earlier tree, whose nodes are freed first.
+int sha512_merkle_build(SHA512Merkle* tree, const uint8_t* const* leaves, const size_t* lengths, size_t count, unsigned threads);
+
+void sha512_merkle_free(SHA512Merkle* tree);
+
+//The root of an empty tree is SHA512 of the empty string
+void sha512_merkle_root(const SHA512Merkle* tree, uint8_t root[64]);
+
+//Both rehash only the path from the leaf to the root; update returns -1 for an index past the end,
+//append returns -1 if growing the array runs out of memory
+int sha512_merkle_update(SHA512Merkle* tree, size_t index, const void* leaf, size_t length);
+
+int sha512_merkle_append(SHA512Merkle* tree, const void* leaf, size_t length);
+
+//Writes the sibling hashes from the leaf upwards and returns how many; proof must hold 64 * 64 bytes
+size_t sha512_merkle_proof(const SHA512Merkle* tree, size_t index, uint8_t* proof);
+
+//Returns 1 if leaf is at index in a tree of number_of_leaves leaves with this root, 0 otherwise
+int sha512_merkle_verify(const uint8_t root[64], size_t index, size_t number_of_leaves, const void* leaf, size_t length, const uint8_t* proof, size_t siblings);
+
+//Compression backends are chosen once at startup; forcing one returns -1 if the CPU lacks it.
+//Do not switch backends while other threads are hashing.
+int sha512_set_backend(SHA512Backend backend);
+
+SHA512Backend sha512_get_backend(void);
+
+//Known-answer tests (FIPS 180 examples, padding boundaries, Monte Carlo, checkpoint round trips) on the backends selected now; returns the number of failures
+int sha512_known_answers(void);
+
+//Runs the known-answer tests on every backend this CPU supports, then restores the selection; returns the number of failures
+int sha512_selftest(void);
+
+//chunk_size 0 means 1 MiB, threads 0 means all online cores; returns -1 if out of memory
+int sha512_tree_hash(const void* data, size_t length, const SHA512TreeParams* params, uint8_t digest[64]);
+
+void sha512_compress(uint64_t hashes[8], const uint8_t* blocks, uint64_t number_of_blocks);
+
+#endif
\ No newline at end of file
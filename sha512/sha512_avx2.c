@@ -0,0 +1,103 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha512_avx2.c - SHA512 compression function with an AVX2 message schedule and BMI2 rounds
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include "sha512_stats.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+
+#define RotR4(A, n) _mm256_or_si256(_mm256_srli_epi64(A, n), _mm256_slli_epi64(A, 64 - (n)))
+#define s0_4(X) _mm256_xor_si256(_mm256_xor_si256(RotR4(X, 1), RotR4(X, 8)), _mm256_srli_epi64(X, 7))
+#define s1_4(X) _mm256_xor_si256(_mm256_xor_si256(RotR4(X, 19), RotR4(X, 61)), _mm256_srli_epi64(X, 6))
+
+//Words 1..3 of A followed by word 0 of B
+#define Next4(A, B) _mm256_permute4x64_epi64(_mm256_blend_epi32(A, B, 0x03), 0x39)
+
+//With BMI2 enabled the rotates in S0/S1 compile to rorx, which leaves the flags and its source alone
+#define Round(a, b, c, d, e, f, g, h, r) \
+	{ \
+		uint64_t T1 = h + S1(e) + Ch(e, f, g) + WK[r]; \
+		d += T1; \
+		h = T1 + S0(a) + Maj(a, b, c); \
+	}
+
+//Expands the schedule of up to two blocks side by side, four words at a time, and adds K
+__attribute__((target("avx2")))
+static inline void schedule(const uint8_t* blocks, uint8_t number_of_blocks, uint64_t WK[2][80])
+{
+	const __m256i byte_swap = _mm256_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i W[2][20];
+
+	for(uint8_t q = 0; q < 20; q++)
+	{
+		for(uint8_t b = 0; b < number_of_blocks; b++)
+		{
+			if(q < 4)
+			{
+				W[b][q] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (blocks + 128 * b + 32 * q)), byte_swap);
+			}
+			else
+			{
+				__m256i partial = _mm256_add_epi64(_mm256_add_epi64(W[b][q - 4], s0_4(Next4(W[b][q - 4], W[b][q - 3]))), Next4(W[b][q - 2], W[b][q - 1]));
+				__m256i low = _mm256_add_epi64(partial, s1_4(_mm256_permute4x64_epi64(W[b][q - 1], 0x0E)));
+				__m256i high = _mm256_add_epi64(partial, s1_4(_mm256_permute4x64_epi64(low, 0x40)));
+				W[b][q] = _mm256_blend_epi32(low, high, 0xF0);
+			}
+
+			_mm256_store_si256((__m256i *) (WK[b] + 4 * q), _mm256_add_epi64(W[b][q], _mm256_loadu_si256((const __m256i *) (K + 4 * q))));
+		}
+	}
+}
+
+__attribute__((target("avx2,bmi2")))
+void sha512_compress_avx2(uint64_t hashes[8], const uint8_t* blocks, uint64_t number_of_blocks)
+{
+	__attribute__((aligned(32))) uint64_t schedules[2][80];
+	STATS_BLOCKS(SHA512_KERNEL_AVX2, number_of_blocks);
+
+	for(uint64_t i = 0; i < number_of_blocks; i += 2)
+	{
+		uint8_t pair = number_of_blocks - i > 1 ? 2 : 1;
+
+		schedule(blocks + 128 * i, pair, schedules);
+
+		for(uint8_t p = 0; p < pair; p++)
+		{
+			const uint64_t* WK = schedules[p];
+			uint64_t a = hashes[0];
+			uint64_t b = hashes[1];
+			uint64_t c = hashes[2];
+			uint64_t d = hashes[3];
+			uint64_t e = hashes[4];
+			uint64_t f = hashes[5];
+			uint64_t g = hashes[6];
+			uint64_t h = hashes[7];
+
+			for(uint8_t r = 0; r < 80; r += 8)
+			{
+				Round(a, b, c, d, e, f, g, h, r);
+				Round(h, a, b, c, d, e, f, g, r + 1);
+				Round(g, h, a, b, c, d, e, f, r + 2);
+				Round(f, g, h, a, b, c, d, e, r + 3);
+				Round(e, f, g, h, a, b, c, d, r + 4);
+				Round(d, e, f, g, h, a, b, c, r + 5);
+				Round(c, d, e, f, g, h, a, b, r + 6);
+				Round(b, c, d, e, f, g, h, a, r + 7);
+			}
+
+			hashes[0] += a;
+			hashes[1] += b;
+			hashes[2] += c;
+			hashes[3] += d;
+			hashes[4] += e;
+			hashes[5] += f;
+			hashes[6] += g;
+			hashes[7] += h;
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,85 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha512_checkpoint.c - Versioned, big-endian export and import of a context, to resume hashing on appended data
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include "sha512_stats.h"
+
+//"SHA2", version, digest size, bytes in the partial block, a zero byte, then the 128-bit length in bits, the chaining state
+//and the block, all big-endian, and the first 8 bytes of the SHA512 of everything before them
+#define LENGTH_OFFSET 8
+#define HASHES_OFFSET 24
+#define BLOCK_OFFSET 88
+#define CHECK_OFFSET 216
+
+static void store_be(uint8_t* out, uint64_t value, uint8_t bytes)
+{
+    for(uint8_t i = 0; i < bytes; i++)
+    {
+        *(out + i) = (uint8_t) (value >> (8 * (bytes - 1 - i)));
+    }
+}
+
+static uint64_t load_be(const uint8_t* in, uint8_t bytes)
+{
+    uint64_t value = 0;
+
+    for(uint8_t i = 0; i < bytes; i++)
+    {
+        value = (value << 8) | *(in + i);
+    }
+    return value;
+}
+
+static void check_value(const uint8_t checkpoint[SHA512_CHECKPOINT_SIZE], uint8_t check[8])
+{
+    uint8_t digest[64];
+
+    sha512_digest(checkpoint, CHECK_OFFSET, digest);
+    memcpy(check, digest, 8);
+}
+
+void sha512_export(const Context* ctx, uint8_t checkpoint[SHA512_CHECKPOINT_SIZE])
+{
+    memset(checkpoint, 0, SHA512_CHECKPOINT_SIZE);
+    memcpy(checkpoint, "SHA2", 4);
+    *(checkpoint + 4) = SHA512_CHECKPOINT_VERSION;
+    *(checkpoint + 5) = 64;
+    *(checkpoint + 6) = ctx->block_length;
+
+    store_be(checkpoint + LENGTH_OFFSET, (uint64_t) (ctx->length_in_bits >> 64), 8);
+    store_be(checkpoint + LENGTH_OFFSET + 8, (uint64_t) ctx->length_in_bits, 8);
+    for(uint8_t i = 0; i < 8; i++)
+    {
+        store_be(checkpoint + HASHES_OFFSET + 8 * i, ctx->hashes[i], 8);
+    }
+    //Only the buffered bytes are meaningful; the rest of the block stays zero so equal states export equally
+    memcpy(checkpoint + BLOCK_OFFSET, ctx->block, ctx->block_length);
+
+    check_value(checkpoint, checkpoint + CHECK_OFFSET);
+}
+
+int sha512_import(Context* ctx, const uint8_t checkpoint[SHA512_CHECKPOINT_SIZE])
+{
+    uint8_t check[8];
+    uint128_t length_in_bits = ((uint128_t) load_be(checkpoint + LENGTH_OFFSET, 8) << 64) | load_be(checkpoint + LENGTH_OFFSET + 8, 8);
+    uint8_t block_length = *(checkpoint + 6);
+
+    check_value(checkpoint, check);
+    if(memcmp(check, checkpoint + CHECK_OFFSET, 8) != 0 || memcmp(checkpoint, "SHA2", 4) != 0 || *(checkpoint + 4) != SHA512_CHECKPOINT_VERSION ||
+        *(checkpoint + 5) != 64 || *(checkpoint + 7) != 0 || block_length >= 128 || length_in_bits % 8 != 0 || (length_in_bits / 8) % 128 != block_length)
+    {
+        return -1;
+    }
+
+    ctx->length_in_bits = length_in_bits;
+    ctx->block_length = block_length;
+    for(uint8_t i = 0; i < 8; i++)
+    {
+        ctx->hashes[i] = load_be(checkpoint + HASHES_OFFSET + 8 * i, 8);
+    }
+    memset(ctx->block, 0, 128);
+    memcpy(ctx->block, checkpoint + BLOCK_OFFSET, block_length);
+    return 0;
+}
@@ -0,0 +1,84 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha512_hmac.c - HMAC-SHA512 with the ipad/opad blocks compressed once per key
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+//For explicit_bzero
+#define _DEFAULT_SOURCE
+#include "sha512_stats.h"
+
+void sha512_hmac_key(SHA512HMACKey* key, const void* secret, size_t length)
+{
+    uint8_t block[128];
+    Context ctx;
+
+    memset(block, 0, 128);
+    if(length > 128)
+    {
+        sha512_digest(secret, length, block);
+    }
+    else if(length > 0)
+    {
+        memcpy(block, secret, length);
+    }
+
+    for(uint8_t i = 0; i < 128; i++)
+    {
+        *(block + i) ^= 0x36;
+    }
+    sha512_init(&ctx);
+    sha512_compress(ctx.hashes, block, 1);
+    memcpy(key->inner, ctx.hashes, sizeof(key->inner));
+
+    for(uint8_t i = 0; i < 128; i++)
+    {
+        *(block + i) ^= 0x36 ^ 0x5c;
+    }
+    sha512_init(&ctx);
+    sha512_compress(ctx.hashes, block, 1);
+    memcpy(key->outer, ctx.hashes, sizeof(key->outer));
+
+    //The padded key and the midstate are key material, and a plain memset of dead locals may be dropped
+    explicit_bzero(block, 128);
+    explicit_bzero(&ctx, sizeof(ctx));
+}
+
+void sha512_hmac_init(Context* ctx, const SHA512HMACKey* key)
+{
+    memcpy(ctx->hashes, key->inner, sizeof(ctx->hashes));
+    ctx->length_in_bits = 1024;
+    ctx->block_length = 0;
+}
+
+void sha512_hmac_final(Context* ctx, const SHA512HMACKey* key, uint8_t mac[64])
+{
+    uint8_t inner[64];
+
+    sha512_final(ctx, inner);
+
+    memcpy(ctx->hashes, key->outer, sizeof(ctx->hashes));
+    ctx->length_in_bits = 1024;
+    ctx->block_length = 0;
+    sha512_update(ctx, inner, 64);
+    sha512_final(ctx, mac);
+}
+
+void sha512_hmac(const SHA512HMACKey* key, const void* data, size_t length, uint8_t mac[64])
+{
+    Context ctx;
+    STATS_START();
+
+    sha512_hmac_init(&ctx, key);
+    sha512_update(&ctx, data, length);
+    sha512_hmac_final(&ctx, key, mac);
+    STATS_STOP(SHA512_ENTRY_HMAC, length);
+}
+
+void sha512_hmac_many(const SHA512HMACKey* key, const uint8_t* const* messages, const size_t* lengths, size_t count, uint8_t* macs)
+{
+    for(size_t i = 0; i < count; i++)
+    {
+        sha512_hmac(key, messages[i], lengths[i], macs + 64 * i);
+    }
+}
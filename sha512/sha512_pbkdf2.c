@@ -0,0 +1,131 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha512_pbkdf2.c - PBKDF2-HMAC-SHA512 on the cached HMAC midstates
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+//For explicit_bzero
+#define _DEFAULT_SOURCE
+#include "sha512_stats.h"
+
+//Chains set up at once; every array below lives on the stack
+#define WINDOW 64
+
+//U_1 = HMAC(P, salt || INT(i)); the block is left holding U_1 and the padding for a 192-byte message
+static void first_block(const SHA512HMACKey* key, const void* salt, size_t salt_length, uint32_t index, uint8_t block[128])
+{
+    uint8_t counter[4] = { (uint8_t) (index >> 24), (uint8_t) (index >> 16), (uint8_t) (index >> 8), (uint8_t) index };
+    Context ctx;
+
+    sha512_hmac_init(&ctx, key);
+    sha512_update(&ctx, salt, salt_length);
+    sha512_update(&ctx, counter, 4);
+    sha512_hmac_final(&ctx, key, block);
+
+    memset(block + 64, 0, 64);
+    *(block + 64) = 128;
+    *(block + 126) = 0x06;
+}
+
+static void store_words(uint8_t block[128], const uint64_t hashes[8])
+{
+    for(uint8_t i = 0; i < 8; i++)
+    {
+        for(uint8_t j = 0; j < 8; j++)
+        {
+            *(block + 8 * i + j) = (uint8_t) (hashes[i] >> (56 - 8 * j));
+        }
+    }
+}
+
+//Each iteration is two compressions from the cached midstates; the padding is never rebuilt
+static void iterate(const SHA512HMACKey* const* keys, uint8_t (*blocks)[128], uint8_t (*T)[64], size_t count, uint32_t iterations)
+{
+    uint64_t state[8];
+
+    for(size_t i = 0; i < count; i++)
+    {
+        memcpy(T[i], blocks[i], 64);
+
+        for(uint32_t j = 1; j < iterations; j++)
+        {
+            memcpy(state, keys[i]->inner, 64);
+            sha512_compress(state, blocks[i], 1);
+            store_words(blocks[i], state);
+
+            memcpy(state, keys[i]->outer, 64);
+            sha512_compress(state, blocks[i], 1);
+            store_words(blocks[i], state);
+
+            for(uint8_t k = 0; k < 64; k++)
+            {
+                T[i][k] ^= blocks[i][k];
+            }
+        }
+    }
+}
+
+int sha512_pbkdf2_many(const uint8_t* const* passwords, const size_t* password_lengths, size_t count, const void* salt, size_t salt_length, uint32_t iterations, uint8_t* keys, size_t key_length)
+{
+    SHA512HMACKey hmac_keys[WINDOW];
+    const SHA512HMACKey* chain_keys[WINDOW];
+    uint8_t blocks[WINDOW][128];
+    uint8_t T[WINDOW][64];
+    size_t blocks_per_key = (key_length + 63) / 64;
+    size_t total = count * blocks_per_key;
+    STATS_START();
+
+    //PBKDF2 defines at least one iteration; zero is a caller error, not a request for the weakest key
+    if(iterations == 0)
+    {
+        STATS_STOP(SHA512_ENTRY_PBKDF2, 0);
+        return -1;
+    }
+
+    //Chains are numbered password-major; a window may cover several passwords and part of another
+    for(size_t start = 0; start < total; start += WINDOW)
+    {
+        size_t window = total - start < WINDOW ? total - start : WINDOW;
+        size_t first_password = start / blocks_per_key;
+
+        for(size_t c = 0; c < window; c++)
+        {
+            size_t chain = start + c;
+            size_t password = chain / blocks_per_key;
+            SHA512HMACKey* key = &hmac_keys[password - first_password];
+
+            if(c == 0 || chain % blocks_per_key == 0)
+            {
+                sha512_hmac_key(key, passwords[password], password_lengths[password]);
+            }
+
+            chain_keys[c] = key;
+            first_block(key, salt, salt_length, (uint32_t) (chain % blocks_per_key) + 1, blocks[c]);
+        }
+
+        iterate(chain_keys, blocks, T, window, iterations);
+
+        for(size_t c = 0; c < window; c++)
+        {
+            size_t chain = start + c;
+            size_t offset = chain % blocks_per_key * 64;
+            size_t length = key_length - offset < 64 ? key_length - offset : 64;
+
+            memcpy(keys + chain / blocks_per_key * key_length + offset, T[c], length);
+        }
+    }
+
+    //These are dead stores to the compiler, which may drop a plain memset
+    explicit_bzero(hmac_keys, sizeof(hmac_keys));
+    explicit_bzero(blocks, sizeof(blocks));
+    explicit_bzero(T, sizeof(T));
+    STATS_STOP(SHA512_ENTRY_PBKDF2, (uint64_t) count * key_length);
+    return 0;
+}
+
+int sha512_pbkdf2(const void* password, size_t password_length, const void* salt, size_t salt_length, uint32_t iterations, uint8_t* key, size_t key_length)
+{
+    const uint8_t* passwords[1] = { (const uint8_t *) password };
+
+    return sha512_pbkdf2_many(passwords, &password_length, 1, salt, salt_length, iterations, key, key_length);
+}
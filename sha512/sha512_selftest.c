@@ -0,0 +1,225 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha512_selftest.c - Known-answer tests run against every compression backend
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#include "sha512.h"
+
+typedef struct SHA512KnownAnswer{
+    const char* message;
+    size_t repeat;
+    const char* digest;
+} KnownAnswer;
+
+//FIPS 180 examples; the last one is the long message of one million 'a'
+static const KnownAnswer fips_vectors[] = {
+    { "", 1, "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e" },
+    { "abc", 1, "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f" },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1, "204a8fc6dda82f0a0ced7beb8e08a41657c16ef468b228a8279be331a703c33596fd15c13b1b07f9aa1d3bea57789ca031ad85c7a71dd70354ec631238ca3445" },
+    { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1, "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909" },
+    { "aaaaaaaaaa", 100000, "e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973ebde0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b" }
+};
+
+//Messages of byte i = i % 251 around the padding cutoffs: 111 bytes still fit the length in the same block, 112 do not
+#define BOUNDARY_MAX 1000
+static const size_t boundary_lengths[] = { 0, 1, 111, 112, 113, 127, 128, 129, 239, 240, 255, 256, 1000 };
+static const char* const boundary_digests[] = {
+    "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e",
+    "b8244d028981d693af7b456af8efa4cad63d282e19ff14942c246e50d9351d22704a802a71c3580b6370de4ceb293c324a8423342557d4e5c38438f0e36910ee",
+    "a1a111449b198d9b1f538bad7f3fc1022b3a5b1a5e90a0bc860de8512746cbc31599e6c834de3a3235327af0b51ff57bf7acf1974a73014d9c3953812edc7c8d",
+    "c5fbd731d19d2ae1180f001be72c2c1aaba1d7b094b3748880e24593b8e117a750e11c1bd867cc2f96dace8c8b74abd2d5c4f236be444e77d30d1916174070b9",
+    "61b2e77db697dfe5571fff3ed06bd60c41e1e7b7c08a80de01cb16526d9a9a52d690dfbe792278a60f6e2b4c57a97c729773f26e258d2393890c985d645f6715",
+    "eab89674feaa34e27aebeeff3c0a4d70070bb872d5e9f186cf1dbbdee517b6e35724d629ff025a5b07185e911ada7e3c8acf830aa0e4f71777bd2d44f504f7f0",
+    "1dffd5e3adb71d45d2245939665521ae001a317a03720a45732ba1900ca3b8351fc5c9b4ca513eba6f80bc7b1d1fdad4abd13491cb824d61b08d8c0e1561b3f7",
+    "1d9da57fbbdab09afb3506ab2d223d06109d65c1c8ad197f50138f714bc4c3f2fe5787922639c680acad1c651f955990425954ce2cba0c5cc83f2667d878eb0f",
+    "cb4c7fd522756d5781ad3a4f590a1d862906b960e7720136cb3fb36b563caa1ea5689134291fa79c80ccc2b4092b41df32ebdcb36dbe79db483440228c1622a8",
+    "6c48466c9f6c07e4ab762c696b7eeb35cfe236fca73683e5fab873ac3489b4d2eb3d7afcce7e8165dbbf37aded3b5b0c889c0b7e0f1790a8330d8677429d91a5",
+    "e9746a5516961da1fdc8e6c59350cd147b7d80c120cc7ed621399faeb2462c28f34217a13009a8e6a721f538356db9a9b64d9a5412e0fd07d24cac1315d95548",
+    "7ff1cd1e9773a4b7ba1f40e642db0d879bd5f6cc151a7d3401a0bc7778b8270c108b530fb195f2383f4cec8cf05778e6af4db56811673371674cec1524488f83",
+    "5096498d96f50f9a137c4db5b8b0cd38383ad55350fb5a98805fedc31fa1262f1f0cf4d6f12d7ecd8dedd933a4c9126344fe22e937a8ad35fdeae1e876ae698b"
+};
+#define NUMBER_OF_BOUNDARIES (sizeof(boundary_lengths) / sizeof(boundary_lengths[0]))
+
+//SHAVS Monte Carlo procedure: 100 checkpoints of 1000 chained hashes of MD[i-3] || MD[i-2] || MD[i-1].
+//The seed is SHA512("crypto_algorithms monte carlo seed"); the answer is checkpoint 99.
+static const char monte_carlo_seed[] = "e1506d4f891a8f51bfc10bfeee9c10056962a2b6109d497ba24d3616449718608caf13a0350827cfe0758152559b9794f1bab9752582ecf62c69c61fe7c1450c";
+static const char monte_carlo_digest[] = "9953b482a7c9bcaa8af90adf9a92264e990ac0fd74eb6832de036f89f140c2fa16365d8fbd55c135e886b780b9b9e61eff975637acd9b8273ba300fcfb95e0f0";
+
+static int mismatch(const uint8_t digest[64], const char* expected)
+{
+    char hex[129];
+
+    sha512_to_hex(digest, hex);
+    return strcmp(hex, expected) != 0;
+}
+
+static int fips_tests(void)
+{
+    int failures = 0;
+
+    for(size_t v = 0; v < sizeof(fips_vectors) / sizeof(fips_vectors[0]); v++)
+    {
+        size_t length = strlen(fips_vectors[v].message);
+        uint8_t digest[64];
+        Context ctx;
+
+        sha512_init(&ctx);
+        for(size_t r = 0; r < fips_vectors[v].repeat; r++)
+        {
+            sha512_update(&ctx, fips_vectors[v].message, length);
+        }
+        sha512_final(&ctx, digest);
+        failures += mismatch(digest, fips_vectors[v].digest);
+
+        if(fips_vectors[v].repeat == 1)
+        {
+            sha512_digest(fips_vectors[v].message, length, digest);
+            failures += mismatch(digest, fips_vectors[v].digest);
+        }
+    }
+
+    return failures;
+}
+
+//Each boundary message goes through the one-shot path, byte by byte through the buffered path,
+//and as a suffix after a one-byte prefix
+static int boundary_tests(const uint8_t* pattern)
+{
+    const uint8_t* suffixes[NUMBER_OF_BOUNDARIES - 1];
+    size_t suffix_lengths[NUMBER_OF_BOUNDARIES - 1];
+    uint8_t digests[64 * (NUMBER_OF_BOUNDARIES - 1)];
+    int failures = 0;
+    Context prefix;
+
+    for(size_t v = 0; v < NUMBER_OF_BOUNDARIES; v++)
+    {
+        uint8_t digest[64];
+        Context ctx;
+
+        sha512_digest(pattern, boundary_lengths[v], digest);
+        failures += mismatch(digest, boundary_digests[v]);
+
+        sha512_init(&ctx);
+        for(size_t i = 0; i < boundary_lengths[v]; i++)
+        {
+            sha512_update(&ctx, pattern + i, 1);
+        }
+        sha512_final(&ctx, digest);
+        failures += mismatch(digest, boundary_digests[v]);
+    }
+
+    for(size_t v = 1; v < NUMBER_OF_BOUNDARIES; v++)
+    {
+        suffixes[v - 1] = pattern + 1;
+        suffix_lengths[v - 1] = boundary_lengths[v] - 1;
+    }
+    sha512_init(&prefix);
+    sha512_update(&prefix, pattern, 1);
+
+    sha512_hash_many_after(&prefix, suffixes, suffix_lengths, NUMBER_OF_BOUNDARIES - 1, digests);
+    for(size_t v = 1; v < NUMBER_OF_BOUNDARIES; v++)
+    {
+        failures += mismatch(digests + 64 * (v - 1), boundary_digests[v]);
+    }
+
+    return failures;
+}
+
+static int monte_carlo_test(void)
+{
+    uint8_t md[3][64];
+    uint8_t seed[64];
+    uint8_t message[192];
+
+    for(uint8_t i = 0; i < 64; i++)
+    {
+        char byte[3] = { monte_carlo_seed[2 * i], monte_carlo_seed[2 * i + 1], 0 };
+        seed[i] = (uint8_t) strtoul(byte, NULL, 16);
+    }
+
+    for(uint8_t j = 0; j < 100; j++)
+    {
+        memcpy(md[0], seed, 64);
+        memcpy(md[1], seed, 64);
+        memcpy(md[2], seed, 64);
+
+        for(uint16_t i = 3; i < 1003; i++)
+        {
+            memcpy(message, md[0], 64);
+            memcpy(message + 64, md[1], 64);
+            memcpy(message + 128, md[2], 64);
+            memmove(md[0], md[1], 128);
+            sha512_digest(message, 192, md[2]);
+        }
+
+        memcpy(seed, md[2], 64);
+    }
+
+    return mismatch(seed, monte_carlo_digest);
+}
+
+//Every boundary message is split at every shorter boundary length, checkpointed there and resumed in a fresh context;
+//a checkpoint with one byte changed must be refused
+static int checkpoint_tests(const uint8_t* pattern)
+{
+    int failures = 0;
+
+    for(size_t v = 0; v < NUMBER_OF_BOUNDARIES; v++)
+    {
+        for(size_t s = 0; s <= v; s++)
+        {
+            uint8_t checkpoint[SHA512_CHECKPOINT_SIZE];
+            uint8_t digest[64];
+            Context ctx;
+
+            sha512_init(&ctx);
+            sha512_update(&ctx, pattern, boundary_lengths[s]);
+            sha512_export(&ctx, checkpoint);
+
+            memset(&ctx, 0xa5, sizeof(Context));
+            if(sha512_import(&ctx, checkpoint) != 0)
+            {
+                failures++;
+                continue;
+            }
+            sha512_update(&ctx, pattern + boundary_lengths[s], boundary_lengths[v] - boundary_lengths[s]);
+            sha512_final(&ctx, digest);
+            failures += mismatch(digest, boundary_digests[v]);
+
+            *(checkpoint + (boundary_lengths[v] * 7) % SHA512_CHECKPOINT_SIZE) ^= 1;
+            failures += sha512_import(&ctx, checkpoint) != -1;
+        }
+    }
+
+    return failures;
+}
+
+int sha512_known_answers(void)
+{
+    uint8_t pattern[BOUNDARY_MAX];
+
+    for(size_t i = 0; i < BOUNDARY_MAX; i++)
+    {
+        *(pattern + i) = (uint8_t) (i % 251);
+    }
+
+    return fips_tests() + boundary_tests(pattern) + monte_carlo_test() + checkpoint_tests(pattern);
+}
+
+int sha512_selftest(void)
+{
+    SHA512Backend backend = sha512_get_backend();
+    int failures = 0;
+
+    for(SHA512Backend b = SHA512_BACKEND_SCALAR; b <= SHA512_BACKEND_AVX2; b++)
+    {
+        if(sha512_set_backend(b) == 0)
+        {
+            failures += sha512_known_answers();
+        }
+    }
+
+    sha512_set_backend(backend);
+    return failures;
+}
@@ -0,0 +1,37 @@
+//License: GNU General Public License, Version 3
+/*
+ *   sha512_stats.h - Internal instrumentation hooks; every hook expands to nothing without SHA512_STATS
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#ifndef SHA512_STATS_H
+#define SHA512_STATS_H
+#include "sha512.h"
+
+#ifdef SHA512_STATS
+uint64_t sha512_stats_clock(void);
+
+void sha512_stats_record(SHA512StatsEntry entry, uint64_t bytes, uint64_t start);
+
+void sha512_stats_blocks(SHA512StatsKernel kernel, uint64_t blocks);
+
+#define STATS_START() uint64_t stats_start = sha512_stats_clock()
+#define STATS_STOP(entry, bytes) sha512_stats_record(entry, bytes, stats_start)
+#define STATS_BLOCKS(kernel, blocks) sha512_stats_blocks(kernel, blocks)
+
+static inline uint64_t stats_total(const size_t* lengths, size_t count)
+{
+    uint64_t total = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        total += lengths[i];
+    }
+    return total;
+}
+#else
+#define STATS_START()
+#define STATS_STOP(entry, bytes)
+#define STATS_BLOCKS(kernel, blocks)
+#endif
+
+#endif
@@ -0,0 +1,882 @@
+//License: GNU General Public License, Version 3
+/*
+ *   shasum.c - sha256sum/sha512sum compatible command line front end
+ *
+ *   Built once per algorithm:
+ *       cc -O2 -pthread shasum.c shasum_cache.c ../sha256/sha256*.c -o sha256sum
+ *       cc -O2 -pthread -DSHASUM_SHA512 shasum.c shasum_cache.c ../sha512/sha512*.c -o sha512sum
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "shasum_cache.h"
+
+#ifdef SHASUM_SHA512
+#include "../sha512/sha512.h"
+#define PROGRAM "sha512sum"
+#define DIGEST_LENGTH 64
+#define CACHE_ALGORITHM 512
+#define digest_init sha512_init
+#define digest_update sha512_update
+#define digest_final sha512_final
+#define digest_data sha512_digest
+#define digest_to_hex sha512_to_hex
+#else
+#include "../sha256/sha256.h"
+#define PROGRAM "sha256sum"
+#define DIGEST_LENGTH 32
+#define CACHE_ALGORITHM 256
+#define digest_init sha256_init
+#define digest_update sha256_update
+#define digest_final sha256_final
+#define digest_data sha256_digest
+#define digest_to_hex sha256_to_hex
+#endif
+
+#define BUFFER_SIZE (1 << 20)
+#define MMAP_THRESHOLD (1 << 20)
+//Files modified this close to the start of hashing are not cached, since a later write may keep the same mtime
+#define RACY_NS 1000000000
+
+typedef struct ShasumEntry{
+	char* name;
+	uint8_t digest[DIGEST_LENGTH];
+	int binary;
+	int match;
+	int error;
+	int done;
+} Entry;
+
+typedef struct ShasumJob{
+	Entry* entries;
+	size_t count;
+	size_t next;
+	//Index of the "-" entry allowed to read standard input next, so repeated "-" operands read it in order
+	size_t stdin_turn;
+	int check;
+	ShasumCache* cache;
+	pthread_mutex_t lock;
+	pthread_cond_t finished;
+} Job;
+
+typedef struct ShasumPipeline{
+	int fd;
+	uint8_t* buffers[2];
+	ssize_t filled[2];
+	int error;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+} Pipeline;
+
+#define EMPTY (-1)
+
+//Reader half of the double-buffered path: fills one buffer while the other is being hashed
+static void* read_ahead(void* argument)
+{
+	Pipeline* pipeline = (Pipeline *) argument;
+
+	for(uint8_t b = 0; ; b ^= 1)
+	{
+		pthread_mutex_lock(&pipeline->lock);
+		while(pipeline->filled[b] != EMPTY)
+		{
+			pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+		}
+		pthread_mutex_unlock(&pipeline->lock);
+
+		ssize_t total = 0;
+		int error = 0;
+
+		while(total < BUFFER_SIZE)
+		{
+			ssize_t n = read(pipeline->fd, pipeline->buffers[b] + total, BUFFER_SIZE - total);
+			if(n < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if(n < 0)
+			{
+				error = errno;
+				break;
+			}
+			if(n == 0)
+			{
+				break;
+			}
+			total += n;
+		}
+
+		pthread_mutex_lock(&pipeline->lock);
+		pipeline->filled[b] = total;
+		pipeline->error = error;
+		pthread_cond_broadcast(&pipeline->changed);
+		pthread_mutex_unlock(&pipeline->lock);
+
+		if(total < BUFFER_SIZE)
+		{
+			return NULL;
+		}
+	}
+}
+
+static int hash_pipelined(int fd, uint8_t digest[DIGEST_LENGTH])
+{
+	Pipeline pipeline;
+	pthread_t reader;
+	Context ctx;
+	int error = 0;
+
+	pipeline.fd = fd;
+	pipeline.buffers[0] = (uint8_t *) malloc(2 * BUFFER_SIZE);
+	pipeline.buffers[1] = pipeline.buffers[0] + BUFFER_SIZE;
+	pipeline.filled[0] = EMPTY;
+	pipeline.filled[1] = EMPTY;
+	pipeline.error = 0;
+
+	if(pipeline.buffers[0] == NULL)
+	{
+		return ENOMEM;
+	}
+
+	pthread_mutex_init(&pipeline.lock, NULL);
+	pthread_cond_init(&pipeline.changed, NULL);
+
+	if(pthread_create(&reader, NULL, read_ahead, &pipeline) != 0)
+	{
+		free(pipeline.buffers[0]);
+		return EAGAIN;
+	}
+
+	digest_init(&ctx);
+
+	for(uint8_t b = 0; ; b ^= 1)
+	{
+		pthread_mutex_lock(&pipeline.lock);
+		while(pipeline.filled[b] == EMPTY)
+		{
+			pthread_cond_wait(&pipeline.changed, &pipeline.lock);
+		}
+		ssize_t filled = pipeline.filled[b];
+		error = pipeline.error;
+		pthread_mutex_unlock(&pipeline.lock);
+
+		digest_update(&ctx, pipeline.buffers[b], filled);
+
+		pthread_mutex_lock(&pipeline.lock);
+		pipeline.filled[b] = EMPTY;
+		pthread_cond_broadcast(&pipeline.changed);
+		pthread_mutex_unlock(&pipeline.lock);
+
+		if(filled < BUFFER_SIZE || error != 0)
+		{
+			break;
+		}
+	}
+
+	pthread_join(reader, NULL);
+	pthread_cond_destroy(&pipeline.changed);
+	pthread_mutex_destroy(&pipeline.lock);
+	free(pipeline.buffers[0]);
+
+	digest_final(&ctx, digest);
+	return error;
+}
+
+static int hash_small(int fd, uint8_t* buffer, uint8_t digest[DIGEST_LENGTH])
+{
+	Context ctx;
+	digest_init(&ctx);
+
+	for(;;)
+	{
+		ssize_t n = read(fd, buffer, BUFFER_SIZE);
+		if(n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if(n < 0)
+		{
+			return errno;
+		}
+		if(n == 0)
+		{
+			break;
+		}
+		digest_update(&ctx, buffer, n);
+	}
+
+	digest_final(&ctx, digest);
+	return 0;
+}
+
+//Set while this thread reads a mapping, so that a file truncated underneath it fails alone instead of killing the process
+static _Thread_local sigjmp_buf* mapping_fault;
+
+static void on_sigbus(int signal_number)
+{
+	if(mapping_fault != NULL)
+	{
+		siglongjmp(*mapping_fault, 1);
+	}
+
+	signal(signal_number, SIG_DFL);
+	raise(signal_number);
+}
+
+static int hash_mapped(const uint8_t* data, size_t length, uint8_t digest[DIGEST_LENGTH])
+{
+	sigjmp_buf fault;
+
+	if(sigsetjmp(fault, 1) != 0)
+	{
+		mapping_fault = NULL;
+		return EIO;
+	}
+
+	mapping_fault = &fault;
+	madvise((void *) data, length, MADV_SEQUENTIAL);
+	digest_data(data, length, digest);
+	mapping_fault = NULL;
+	return 0;
+}
+
+//Keys regular files and notes when hashing starts, for remember() on a miss
+static int cached_digest(ShasumCache* cache, const struct stat* st, ShasumCacheKey* key, int64_t* started_ns, uint8_t digest[DIGEST_LENGTH])
+{
+	struct timespec now;
+
+	if(cache == NULL || !S_ISREG(st->st_mode))
+	{
+		return 0;
+	}
+
+	shasum_cache_key(key, st, CACHE_ALGORITHM);
+	clock_gettime(CLOCK_REALTIME, &now);
+	*started_ns = (int64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+	return shasum_cache_lookup(cache, key, digest, DIGEST_LENGTH);
+}
+
+//Stores the digest unless the file changed while it was read or was modified too recently for its mtime to be trusted
+static void remember(ShasumCache* cache, int fd, const ShasumCacheKey* key, int64_t started_ns, const uint8_t digest[DIGEST_LENGTH])
+{
+	struct stat st;
+	ShasumCacheKey after;
+
+	if(fstat(fd, &st) != 0)
+	{
+		return;
+	}
+
+	shasum_cache_key(&after, &st, CACHE_ALGORITHM);
+	if(after.device == key->device && after.inode == key->inode && after.size == key->size && after.mtime_ns == key->mtime_ns && key->mtime_ns < started_ns - RACY_NS)
+	{
+		shasum_cache_store(cache, key, digest, DIGEST_LENGTH);
+	}
+}
+
+//Large regular files are mapped and hashed in place; everything else goes through read().
+//With a cache, a regular file whose identity, size and mtime are unchanged is not read at all.
+//Standard input is hashed from its current offset and left at the end, as coreutils does, so it bypasses the cache.
+static int hash_file(const char* name, uint8_t* buffer, uint8_t digest[DIGEST_LENGTH], ShasumCache* cache)
+{
+	int fd = strcmp(name, "-") == 0 ? STDIN_FILENO : open(name, O_RDONLY);
+	struct stat st;
+	ShasumCacheKey key;
+	int64_t started_ns = 0;
+	off_t offset = 0;
+	int cached = 0;
+	int error;
+
+	if(fd < 0)
+	{
+		return errno;
+	}
+	if(fd == STDIN_FILENO)
+	{
+		cache = NULL;
+	}
+
+	if(fstat(fd, &st) != 0)
+	{
+		error = errno;
+	}
+	else if(S_ISDIR(st.st_mode))
+	{
+		error = EISDIR;
+	}
+	else if((cached = cached_digest(cache, &st, &key, &started_ns, digest)) != 0)
+	{
+		error = 0;
+	}
+	else if(S_ISREG(st.st_mode) && (fd == STDIN_FILENO && (offset = lseek(fd, 0, SEEK_CUR)) < 0))
+	{
+		error = errno;
+	}
+	else if(S_ISREG(st.st_mode) && st.st_size - offset < MMAP_THRESHOLD)
+	{
+		error = hash_small(fd, buffer, digest);
+	}
+	else
+	{
+		//The mapping starts on the page holding offset
+		off_t start = offset - offset % sysconf(_SC_PAGESIZE);
+		void* data = S_ISREG(st.st_mode) ? mmap(NULL, st.st_size - start, PROT_READ, MAP_PRIVATE, fd, start) : MAP_FAILED;
+
+		if(data != MAP_FAILED)
+		{
+			error = hash_mapped((const uint8_t *) data + (offset - start), st.st_size - offset, digest);
+			munmap(data, st.st_size - start);
+			if(error == 0 && fd == STDIN_FILENO && lseek(fd, st.st_size, SEEK_SET) < 0)
+			{
+				error = errno;
+			}
+		}
+		else
+		{
+			error = hash_pipelined(fd, digest);
+		}
+	}
+
+	if(cache != NULL && error == 0 && !cached && S_ISREG(st.st_mode))
+	{
+		remember(cache, fd, &key, started_ns, digest);
+	}
+
+	if(fd != STDIN_FILENO)
+	{
+		close(fd);
+	}
+	return error;
+}
+
+static size_t next_stdin(const Entry* entries, size_t count, size_t from)
+{
+	while(from < count && strcmp(entries[from].name, "-") != 0)
+	{
+		from++;
+	}
+	return from;
+}
+
+static void* worker(void* argument)
+{
+	Job* job = (Job *) argument;
+	uint8_t* buffer = (uint8_t *) malloc(BUFFER_SIZE);
+
+	for(;;)
+	{
+		pthread_mutex_lock(&job->lock);
+		size_t i = job->next++;
+		pthread_mutex_unlock(&job->lock);
+
+		if(i >= job->count)
+		{
+			break;
+		}
+
+		Entry* entry = &job->entries[i];
+		uint8_t digest[DIGEST_LENGTH];
+		int reads_stdin = strcmp(entry->name, "-") == 0;
+
+		//Earlier "-" entries were claimed first and never wait on later ones, so this cannot deadlock
+		if(reads_stdin)
+		{
+			pthread_mutex_lock(&job->lock);
+			while(job->stdin_turn != i)
+			{
+				pthread_cond_wait(&job->finished, &job->lock);
+			}
+			pthread_mutex_unlock(&job->lock);
+		}
+
+		int error = buffer != NULL ? hash_file(entry->name, buffer, digest, job->cache) : ENOMEM;
+
+		pthread_mutex_lock(&job->lock);
+		if(reads_stdin)
+		{
+			job->stdin_turn = next_stdin(job->entries, job->count, i + 1);
+		}
+		entry->error = error;
+		if(error == 0 && job->check)
+		{
+			entry->match = memcmp(digest, entry->digest, DIGEST_LENGTH) == 0;
+		}
+		else if(error == 0)
+		{
+			memcpy(entry->digest, digest, DIGEST_LENGTH);
+		}
+		entry->done = 1;
+		pthread_cond_broadcast(&job->finished);
+		pthread_mutex_unlock(&job->lock);
+	}
+
+	free(buffer);
+	return NULL;
+}
+
+//File names holding a backslash or newline are escaped and the line is prefixed with a backslash, as coreutils does.
+//Check results are only escaped for a newline; a backslash alone is printed as it is.
+static int needs_escape(const char* name, int check)
+{
+	return (!check && strchr(name, '\\') != NULL) || strchr(name, '\n') != NULL;
+}
+
+static void print_name(const char* name, int check)
+{
+	if(!needs_escape(name, check))
+	{
+		fputs(name, stdout);
+		return;
+	}
+
+	for(; *name != '\0'; name++)
+	{
+		if(*name == '\\')
+		{
+			fputs("\\\\", stdout);
+		}
+		else if(*name == '\n')
+		{
+			fputs("\\n", stdout);
+		}
+		else
+		{
+			putchar(*name);
+		}
+	}
+}
+
+static int unescape_name(char* name)
+{
+	char* out = name;
+
+	for(; *name != '\0'; name++)
+	{
+		if(*name != '\\')
+		{
+			*out++ = *name;
+			continue;
+		}
+
+		name++;
+		if(*name == '\\')
+		{
+			*out++ = '\\';
+		}
+		else if(*name == 'n')
+		{
+			*out++ = '\n';
+		}
+		else
+		{
+			return -1;
+		}
+	}
+
+	*out = '\0';
+	return 0;
+}
+
+static int hex_value(char c)
+{
+	if(c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if(c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	if(c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+//Parses "<hex>  <name>" or "<hex> *<name>"; returns -1 for anything else
+static int parse_line(char* line, Entry* entry)
+{
+	int escaped = *line == '\\';
+	size_t length = strlen(line);
+
+	if(length > 0 && line[length - 1] == '\n')
+	{
+		line[--length] = '\0';
+	}
+
+	line += escaped;
+
+	for(uint8_t i = 0; i < DIGEST_LENGTH; i++)
+	{
+		int high = hex_value(line[2 * i]);
+		int low = high < 0 ? -1 : hex_value(line[2 * i + 1]);
+
+		if(low < 0)
+		{
+			return -1;
+		}
+		entry->digest[i] = (uint8_t) (high << 4 | low);
+	}
+
+	line += 2 * DIGEST_LENGTH;
+
+	if(line[0] != ' ' || (line[1] != ' ' && line[1] != '*') || line[2] == '\0')
+	{
+		return -1;
+	}
+
+	entry->name = strdup(line + 2);
+	if(entry->name == NULL || (escaped && unescape_name(entry->name) != 0))
+	{
+		free(entry->name);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int read_checksums(const char* list, Entry** listed, size_t* count, size_t* malformed)
+{
+	FILE* file = strcmp(list, "-") == 0 ? stdin : fopen(list, "r");
+	Entry* entries = NULL;
+	size_t capacity = 0;
+	char* line = NULL;
+	size_t line_capacity = 0;
+
+	*count = 0;
+	*malformed = 0;
+
+	if(file == NULL)
+	{
+		fprintf(stderr, PROGRAM ": %s: %s\n", list, strerror(errno));
+		return -1;
+	}
+
+	while(getline(&line, &line_capacity, file) != -1)
+	{
+		if(*count == capacity)
+		{
+			size_t grown = capacity == 0 ? 1024 : 2 * capacity;
+			Entry* larger = (Entry *) realloc(entries, sizeof(Entry) * grown);
+
+			if(larger == NULL)
+			{
+				fprintf(stderr, PROGRAM ": %s: %s\n", list, strerror(ENOMEM));
+				for(size_t i = 0; i < *count; i++)
+				{
+					free(entries[i].name);
+				}
+				free(entries);
+				free(line);
+				if(file != stdin)
+				{
+					fclose(file);
+				}
+				*count = 0;
+				return -1;
+			}
+			entries = larger;
+			capacity = grown;
+		}
+
+		memset(&entries[*count], 0, sizeof(Entry));
+		if(parse_line(line, &entries[*count]) == 0)
+		{
+			(*count)++;
+		}
+		else
+		{
+			(*malformed)++;
+		}
+	}
+
+	free(line);
+	if(file != stdin)
+	{
+		fclose(file);
+	}
+
+	*listed = entries;
+	return 0;
+}
+
+//Hashes every entry on a bounded pool and reports results in input order as they complete
+static int run(Entry* entries, size_t count, int check, size_t malformed, ShasumCache* cache, long jobs, int quiet, int status)
+{
+	Job job;
+	size_t failed = 0;
+	size_t unreadable = 0;
+	pthread_t* workers;
+	long started = 0;
+
+	if((size_t) jobs > count)
+	{
+		jobs = count > 0 ? (long) count : 1;
+	}
+	workers = (pthread_t *) malloc(sizeof(pthread_t) * jobs);
+
+	job.entries = entries;
+	job.count = count;
+	job.next = 0;
+	job.stdin_turn = next_stdin(entries, count, 0);
+	job.check = check;
+	job.cache = cache;
+	pthread_mutex_init(&job.lock, NULL);
+	pthread_cond_init(&job.finished, NULL);
+
+	while(workers != NULL && started < jobs && pthread_create(&workers[started], NULL, worker, &job) == 0)
+	{
+		started++;
+	}
+	if(started == 0)
+	{
+		worker(&job);
+	}
+
+	for(size_t i = 0; i < count; i++)
+	{
+		Entry* entry = &entries[i];
+
+		pthread_mutex_lock(&job.lock);
+		while(!entry->done)
+		{
+			pthread_cond_wait(&job.finished, &job.lock);
+		}
+		pthread_mutex_unlock(&job.lock);
+
+		if(entry->error != 0)
+		{
+			unreadable++;
+			if(!status)
+			{
+				fprintf(stderr, PROGRAM ": %s: %s\n", entry->name, strerror(entry->error));
+			}
+			if(check && !status)
+			{
+				if(needs_escape(entry->name, check))
+				{
+					putchar('\\');
+				}
+				print_name(entry->name, check);
+				fputs(": FAILED open or read\n", stdout);
+			}
+		}
+		else if(check)
+		{
+			failed += !entry->match;
+			if(!status && !(quiet && entry->match))
+			{
+				if(needs_escape(entry->name, check))
+				{
+					putchar('\\');
+				}
+				print_name(entry->name, check);
+				fputs(entry->match ? ": OK\n" : ": FAILED\n", stdout);
+			}
+		}
+		else
+		{
+			char hex[2 * DIGEST_LENGTH + 1];
+
+			digest_to_hex(entry->digest, hex);
+			if(needs_escape(entry->name, check))
+			{
+				putchar('\\');
+			}
+			fputs(hex, stdout);
+			fputs(entry->binary ? " *" : "  ", stdout);
+			print_name(entry->name, check);
+			putchar('\n');
+		}
+	}
+
+	for(long i = 0; i < started; i++)
+	{
+		pthread_join(workers[i], NULL);
+	}
+	free(workers);
+	pthread_cond_destroy(&job.finished);
+	pthread_mutex_destroy(&job.lock);
+
+	//Summaries follow the per-file results in the order coreutils prints them
+	fflush(stdout);
+	if(check && !status && malformed > 0)
+	{
+		fprintf(stderr, PROGRAM ": WARNING: %zu line%s improperly formatted\n", malformed, malformed == 1 ? " is" : "s are");
+	}
+	if(check && !status && unreadable > 0)
+	{
+		fprintf(stderr, PROGRAM ": WARNING: %zu listed file%s could not be read\n", unreadable, unreadable == 1 ? "" : "s");
+	}
+	if(check && !status && failed > 0)
+	{
+		fprintf(stderr, PROGRAM ": WARNING: %zu computed checksum%s did NOT match\n", failed, failed == 1 ? "" : "s");
+	}
+
+	return failed > 0 || unreadable > 0;
+}
+
+static void usage(FILE* out)
+{
+	fprintf(out,
+		"Usage: " PROGRAM " [OPTION]... [FILE]...\n"
+		"Print or check checksums. With no FILE, or when FILE is -, read standard input.\n"
+		"\n"
+		"  -b, --binary     read in binary mode (the same as text mode)\n"
+		"  -t, --text       read in text mode (default)\n"
+		"  -c, --check      read checksums from the FILEs and check them\n"
+		"  -j, --jobs N     hash up to N files at once (default: online cores)\n"
+		"      --cache FILE reuse digests of files unchanged since they were recorded in FILE\n"
+		"  -q, --quiet      do not print OK for each successfully verified file\n"
+		"      --status     do not output anything, status code shows success\n"
+		"  -h, --help       display this help and exit\n");
+}
+
+int main(int argc, char** argv)
+{
+	int binary = 0;
+	int check = 0;
+	int quiet = 0;
+	int status = 0;
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	const char* cache_path = NULL;
+	ShasumCache* cache = NULL;
+	char** names = (char **) malloc(sizeof(char *) * (argc + 1));
+	size_t count = 0;
+	int options = 1;
+
+	for(int i = 1; i < argc; i++)
+	{
+		char* arg = argv[i];
+
+		if(!options || arg[0] != '-' || arg[1] == '\0')
+		{
+			names[count++] = arg;
+		}
+		else if(strcmp(arg, "--") == 0)
+		{
+			options = 0;
+		}
+		else if(strcmp(arg, "-b") == 0 || strcmp(arg, "--binary") == 0)
+		{
+			binary = 1;
+		}
+		else if(strcmp(arg, "-t") == 0 || strcmp(arg, "--text") == 0)
+		{
+			binary = 0;
+		}
+		else if(strcmp(arg, "-c") == 0 || strcmp(arg, "--check") == 0)
+		{
+			check = 1;
+		}
+		else if(strcmp(arg, "-q") == 0 || strcmp(arg, "--quiet") == 0)
+		{
+			quiet = 1;
+		}
+		else if(strcmp(arg, "--status") == 0)
+		{
+			status = 1;
+		}
+		else if((strcmp(arg, "-j") == 0 || strcmp(arg, "--jobs") == 0) && i + 1 < argc)
+		{
+			jobs = atol(argv[++i]);
+		}
+		else if(strcmp(arg, "--cache") == 0 && i + 1 < argc)
+		{
+			cache_path = argv[++i];
+		}
+		else if(strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0)
+		{
+			usage(stdout);
+			return 0;
+		}
+		else
+		{
+			fprintf(stderr, PROGRAM ": unrecognized option '%s'\n", arg);
+			usage(stderr);
+			return 1;
+		}
+	}
+
+	if(count == 0)
+	{
+		names[count++] = "-";
+	}
+	if(jobs < 1)
+	{
+		jobs = 1;
+	}
+	struct sigaction bus;
+
+	memset(&bus, 0, sizeof(bus));
+	bus.sa_handler = on_sigbus;
+	sigemptyset(&bus.sa_mask);
+	sigaction(SIGBUS, &bus, NULL);
+
+	//A cache that cannot be opened only costs speed, so hashing goes ahead without it
+	if(cache_path != NULL && (cache = shasum_cache_open(cache_path)) == NULL && !status)
+	{
+		fprintf(stderr, PROGRAM ": %s: %s\n", cache_path, strerror(errno));
+	}
+
+	int result = 0;
+
+	if(!check)
+	{
+		Entry* entries = (Entry *) calloc(count, sizeof(Entry));
+
+		for(size_t i = 0; i < count; i++)
+		{
+			entries[i].name = names[i];
+			entries[i].binary = binary;
+		}
+
+		result = run(entries, count, 0, 0, cache, jobs, quiet, status);
+		free(entries);
+	}
+	else
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			Entry* entries;
+			size_t listed;
+			size_t malformed;
+
+			if(read_checksums(names[i], &entries, &listed, &malformed) != 0)
+			{
+				result = 1;
+				continue;
+			}
+			if(listed == 0)
+			{
+				fprintf(stderr, PROGRAM ": %s: no properly formatted checksum lines found\n", names[i]);
+				result = 1;
+			}
+			else
+			{
+				result |= run(entries, listed, 1, malformed, cache, jobs, quiet, status);
+			}
+
+			for(size_t j = 0; j < listed; j++)
+			{
+				free(entries[j].name);
+			}
+			free(entries);
+		}
+	}
+
+	shasum_cache_close(cache);
+	free(names);
+	return result;
+}
@@ -0,0 +1,420 @@
+//License: GNU General Public License, Version 3
+/*
+ *   shasum_cache.c - Persistent digest cache: an open-addressed table in one mmap'd file, flock'ed between
+ *   processes and serialised by a mutex between the threads of one process
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#define _GNU_SOURCE
+#include "shasum_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define MAGIC 0x3148534143414853ULL
+#define VERSION 1
+#define MINIMUM_SLOTS 1024
+//Generations (opens of the cache) an entry may go unseen before a rebuild drops it
+#define RETAIN_GENERATIONS 64
+//Times a lock is retried after finding the file replaced underneath it
+#define ATTEMPTS 8
+//digest_length of a slot whose contents are being replaced; its identity is unchanged, so probes still pass it
+#define WRITING 0xff
+
+typedef struct ShasumCacheHeader{
+	uint64_t magic;
+	uint32_t version;
+	uint32_t retired;
+	uint64_t slots;
+	uint64_t used;
+	uint64_t generation;
+	uint8_t reserved[24];
+} Header;
+
+//A slot with digest_length 0 is empty; slots are never freed, only dropped when the table is rebuilt.
+//digest_length is published last, so a writer killed halfway leaves a slot that is empty or WRITING, never a stale match.
+typedef struct ShasumCacheSlot{
+	uint64_t device;
+	uint64_t inode;
+	int64_t size;
+	int64_t mtime_ns;
+	uint64_t generation;
+	uint16_t algorithm;
+	uint8_t digest_length;
+	uint8_t reserved[5];
+	uint8_t digest[SHASUM_CACHE_DIGEST];
+} Slot;
+
+struct ShasumCache{
+	char* path;
+	int fd;
+	Header* header;
+	Slot* slots;
+	size_t mapped;
+	pthread_mutex_t lock;
+};
+
+static size_t file_size(uint64_t slots)
+{
+	return sizeof(Header) + slots * sizeof(Slot);
+}
+
+static uint64_t slot_index(const ShasumCacheKey* key, uint64_t slots)
+{
+	uint64_t x = key->device * 0x9e3779b97f4a7c15ULL ^ key->inode ^ ((uint64_t) key->algorithm << 48);
+
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x & (slots - 1);
+}
+
+//Linear probe for the slot of (device, inode, algorithm), or the empty slot where it would go; NULL if the table is full
+static Slot* find(Slot* slots, uint64_t count, const ShasumCacheKey* key)
+{
+	uint64_t i = slot_index(key, count);
+
+	for(uint64_t probe = 0; probe < count; probe++, i = (i + 1) & (count - 1))
+	{
+		Slot* slot = &slots[i];
+
+		if(slot->digest_length == 0 || (slot->device == key->device && slot->inode == key->inode && slot->algorithm == key->algorithm))
+		{
+			return slot;
+		}
+	}
+
+	return NULL;
+}
+
+static uint8_t published_length(Slot* slot)
+{
+	return __atomic_load_n(&slot->digest_length, __ATOMIC_ACQUIRE);
+}
+
+//Entries worth carrying into a rebuilt table
+static int live_slot(Slot* slot, uint64_t generation)
+{
+	uint8_t length = published_length(slot);
+
+	return length != 0 && length <= SHASUM_CACHE_DIGEST && slot->generation + RETAIN_GENERATIONS > generation;
+}
+
+static void detach(ShasumCache* cache)
+{
+	if(cache->header != NULL)
+	{
+		munmap(cache->header, cache->mapped);
+	}
+	if(cache->fd >= 0)
+	{
+		close(cache->fd);
+	}
+	cache->fd = -1;
+	cache->header = NULL;
+	cache->slots = NULL;
+	cache->mapped = 0;
+}
+
+//Maps fd, which the caller holds exclusively, formatting it first if it is empty or not a cache of this version
+static int attach(ShasumCache* cache, int fd)
+{
+	struct stat st;
+	Header header;
+
+	if(fstat(fd, &st) != 0)
+	{
+		return -1;
+	}
+
+	int valid = (size_t) st.st_size >= sizeof(Header) && pread(fd, &header, sizeof(Header), 0) == (ssize_t) sizeof(Header) &&
+		header.magic == MAGIC && header.version == VERSION && header.slots > 0 && (header.slots & (header.slots - 1)) == 0 &&
+		(size_t) st.st_size == file_size(header.slots);
+
+	if(!valid)
+	{
+		memset(&header, 0, sizeof(Header));
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.slots = MINIMUM_SLOTS;
+
+		if(ftruncate(fd, 0) != 0 || ftruncate(fd, file_size(MINIMUM_SLOTS)) != 0 || pwrite(fd, &header, sizeof(Header), 0) != (ssize_t) sizeof(Header))
+		{
+			return -1;
+		}
+	}
+
+	void* data = mmap(NULL, file_size(header.slots), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(data == MAP_FAILED)
+	{
+		return -1;
+	}
+
+	cache->fd = fd;
+	cache->header = (Header *) data;
+	cache->slots = (Slot *) (cache->header + 1);
+	cache->mapped = file_size(header.slots);
+	return 0;
+}
+
+static int reattach(ShasumCache* cache)
+{
+	int fd = open(cache->path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+	if(fd < 0)
+	{
+		return -1;
+	}
+	if(flock(fd, LOCK_EX) != 0 || attach(cache, fd) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	flock(fd, LOCK_UN);
+	return 0;
+}
+
+//Takes the process mutex and then the file lock; a file found retired has been replaced by a rebuild, so the path is reopened
+static int acquire(ShasumCache* cache, int operation)
+{
+	pthread_mutex_lock(&cache->lock);
+
+	for(uint8_t attempt = 0; attempt < ATTEMPTS; attempt++)
+	{
+		if(cache->fd < 0 && reattach(cache) != 0)
+		{
+			break;
+		}
+		if(flock(cache->fd, operation) == 0 && !cache->header->retired)
+		{
+			return 0;
+		}
+		detach(cache);
+	}
+
+	pthread_mutex_unlock(&cache->lock);
+	return -1;
+}
+
+static void release(ShasumCache* cache)
+{
+	flock(cache->fd, LOCK_UN);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+//Copies the entries seen in the last RETAIN_GENERATIONS into a fresh file with room to spare and renames it over
+//the cache. The old file is marked retired so that processes still holding it reopen the path.
+static int rebuild(ShasumCache* cache)
+{
+	uint64_t generation = cache->header->generation;
+	uint64_t live = 0;
+	uint64_t slots = MINIMUM_SLOTS;
+	size_t length = strlen(cache->path);
+	char* temporary = (char *) malloc(length + 8);
+	struct stat st;
+	int fd;
+
+	for(uint64_t i = 0; i < cache->header->slots; i++)
+	{
+		live += live_slot(&cache->slots[i], generation);
+	}
+	while(slots < 4 * (live + 1))
+	{
+		slots *= 2;
+	}
+
+	if(temporary == NULL)
+	{
+		return -1;
+	}
+	memcpy(temporary, cache->path, length);
+	memcpy(temporary + length, ".XXXXXX", 8);
+
+	fd = mkstemp(temporary);
+	if(fd < 0)
+	{
+		free(temporary);
+		return -1;
+	}
+
+	void* data = MAP_FAILED;
+	if(fstat(cache->fd, &st) != 0 || fchmod(fd, st.st_mode & 0777) != 0 || ftruncate(fd, file_size(slots)) != 0 ||
+		(data = mmap(NULL, file_size(slots), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+	{
+		unlink(temporary);
+		free(temporary);
+		close(fd);
+		return -1;
+	}
+
+	Header* header = (Header *) data;
+	Slot* table = (Slot *) (header + 1);
+
+	header->magic = MAGIC;
+	header->version = VERSION;
+	header->slots = slots;
+	header->generation = generation;
+
+	for(uint64_t i = 0; i < cache->header->slots; i++)
+	{
+		Slot* slot = &cache->slots[i];
+		ShasumCacheKey key = { slot->device, slot->inode, slot->size, slot->mtime_ns, slot->algorithm };
+
+		if(live_slot(slot, generation))
+		{
+			*find(table, slots, &key) = *slot;
+			header->used++;
+		}
+	}
+
+	if(flock(fd, LOCK_EX) != 0 || rename(temporary, cache->path) != 0)
+	{
+		munmap(data, file_size(slots));
+		unlink(temporary);
+		free(temporary);
+		close(fd);
+		return -1;
+	}
+	free(temporary);
+
+	cache->header->retired = 1;
+	detach(cache);
+	cache->fd = fd;
+	cache->header = header;
+	cache->slots = table;
+	cache->mapped = file_size(slots);
+	return 0;
+}
+
+ShasumCache* shasum_cache_open(const char* path)
+{
+	ShasumCache* cache = (ShasumCache *) calloc(1, sizeof(ShasumCache));
+
+	if(cache == NULL || (cache->path = strdup(path)) == NULL)
+	{
+		free(cache);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	cache->fd = -1;
+	pthread_mutex_init(&cache->lock, NULL);
+
+	if(acquire(cache, LOCK_EX) != 0)
+	{
+		int error = errno;
+
+		pthread_mutex_destroy(&cache->lock);
+		free(cache->path);
+		free(cache);
+		errno = error;
+		return NULL;
+	}
+
+	cache->header->generation++;
+	release(cache);
+	return cache;
+}
+
+void shasum_cache_close(ShasumCache* cache)
+{
+	if(cache == NULL)
+	{
+		return;
+	}
+
+	detach(cache);
+	pthread_mutex_destroy(&cache->lock);
+	free(cache->path);
+	free(cache);
+}
+
+void shasum_cache_key(ShasumCacheKey* key, const struct stat* st, uint16_t algorithm)
+{
+	memset(key, 0, sizeof(ShasumCacheKey));
+	key->device = (uint64_t) st->st_dev;
+	key->inode = (uint64_t) st->st_ino;
+	key->size = (int64_t) st->st_size;
+	key->mtime_ns = (int64_t) st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+	key->algorithm = algorithm;
+}
+
+int shasum_cache_lookup(ShasumCache* cache, const ShasumCacheKey* key, uint8_t* digest, uint8_t digest_length)
+{
+	int hit = 0;
+
+	if(acquire(cache, LOCK_SH) != 0)
+	{
+		return 0;
+	}
+
+	Slot* slot = find(cache->slots, cache->header->slots, key);
+	uint64_t generation = cache->header->generation;
+
+	if(slot != NULL && published_length(slot) == digest_length && slot->size == key->size && slot->mtime_ns == key->mtime_ns)
+	{
+		memcpy(digest, slot->digest, digest_length);
+		//Readers share the lock, so the one field they write is stored atomically
+		if(__atomic_load_n(&slot->generation, __ATOMIC_RELAXED) != generation)
+		{
+			__atomic_store_n(&slot->generation, generation, __ATOMIC_RELAXED);
+		}
+		hit = 1;
+	}
+
+	release(cache);
+	return hit;
+}
+
+int shasum_cache_store(ShasumCache* cache, const ShasumCacheKey* key, const uint8_t* digest, uint8_t digest_length)
+{
+	if(digest_length == 0 || digest_length > SHASUM_CACHE_DIGEST || acquire(cache, LOCK_EX) != 0)
+	{
+		return -1;
+	}
+
+	Slot* slot = find(cache->slots, cache->header->slots, key);
+
+	//The table is kept at most half full; rebuilding also drops what has not been seen for a while
+	if(slot != NULL && slot->digest_length == 0 && 2 * (cache->header->used + 1) > cache->header->slots && rebuild(cache) == 0)
+	{
+		slot = find(cache->slots, cache->header->slots, key);
+	}
+
+	if(slot == NULL)
+	{
+		release(cache);
+		return -1;
+	}
+
+	//An occupied slot is withdrawn before its fields change, so no crash can pair a new size and mtime with the old digest
+	if(slot->digest_length == 0)
+	{
+		cache->header->used++;
+	}
+	else
+	{
+		__atomic_store_n(&slot->digest_length, WRITING, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+	}
+	slot->device = key->device;
+	slot->inode = key->inode;
+	slot->size = key->size;
+	slot->mtime_ns = key->mtime_ns;
+	slot->generation = cache->header->generation;
+	slot->algorithm = key->algorithm;
+	memcpy(slot->digest, digest, digest_length);
+	__atomic_store_n(&slot->digest_length, digest_length, __ATOMIC_RELEASE);
+
+	release(cache);
+	return 0;
+}
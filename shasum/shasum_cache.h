@@ -0,0 +1,39 @@
+//License: GNU General Public License, Version 3
+/*
+ *   shasum_cache.h - Persistent digest cache keyed on file identity, shared through mmap between threads and processes
+ *
+ *   Original author: George Tridimas <tridimasg@cardiff.ac.uk>
+ */
+#ifndef SHASUM_CACHE_H
+#define SHASUM_CACHE_H
+#include <stdint.h>
+#include <sys/stat.h>
+
+//Largest digest a slot holds; SHA512 needs all of it
+#define SHASUM_CACHE_DIGEST 64
+
+typedef struct ShasumCache ShasumCache;
+
+//A cached digest is returned only when every field matches; algorithm is the digest size in bits
+typedef struct ShasumCacheKey{
+	uint64_t device;
+	uint64_t inode;
+	int64_t size;
+	int64_t mtime_ns;
+	uint16_t algorithm;
+} ShasumCacheKey;
+
+//Opens or creates the cache at path and starts a new generation; NULL with errno set on failure
+ShasumCache* shasum_cache_open(const char* path);
+
+void shasum_cache_close(ShasumCache* cache);
+
+void shasum_cache_key(ShasumCacheKey* key, const struct stat* st, uint16_t algorithm);
+
+//1 and the digest on a hit, 0 on a miss; a hit marks the entry as seen in this generation
+int shasum_cache_lookup(ShasumCache* cache, const ShasumCacheKey* key, uint8_t* digest, uint8_t digest_length);
+
+//Records or replaces the digest of the file; -1 if the cache could not take it
+int shasum_cache_store(ShasumCache* cache, const ShasumCacheKey* key, const uint8_t* digest, uint8_t digest_length);
+
+#endif